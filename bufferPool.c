@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include "bufferPool.h"
+
+#define POOL_SLAB_CLASS (POOL_CLASSES + 1) //the size class of buffers carved out of a slab
+
+//Every buffer is preceded by a header that remembers it's size class, so that poolRelease doesn't need to be told the size
+typedef union poolHeader{
+    size_t sizeClass; //POOL_CLASSES means the buffer is too big for any class
+    union poolHeader* next; //the next free small buffer, only while it's in the free list
+    max_align_t align;
+} poolHeader;
+
+#define SLAB_STRIDE (sizeof(poolHeader) + POOL_SLAB_SIZE) //a multiple of the header size, so every small buffer stays aligned
+
+/*Slab note
+Small buffers never go through malloc one by one. A slab is a single allocation of POOL_SLAB_BUFFERS of them behind a header linking it to the other slabs.
+Released small buffers go back onto a free list without any cap, so a pool holds on to as many of them as were ever in use at once, until freePool
+*/
+
+//Gets a free small buffer, allocating a new slab if there is none. The caller must hold the pool lock
+static poolHeader* slabAcquire(bufferPool* pool){
+    if(pool->small.free == NULL){
+        poolHeader* slab = malloc(sizeof(poolHeader) + POOL_SLAB_BUFFERS * SLAB_STRIDE);
+        if(slab == NULL){
+            return NULL;
+        }
+        slab->next = pool->small.slabs;
+        pool->small.slabs = slab;
+        char* buffers = (char*)(slab + 1);
+        for(size_t i = 0; i < POOL_SLAB_BUFFERS; i++){
+            poolHeader* header = (poolHeader*)(buffers + i * SLAB_STRIDE);
+            header->next = pool->small.free;
+            pool->small.free = header;
+        }
+    }
+    poolHeader* header = pool->small.free;
+    pool->small.free = header->next;
+    return header;
+}
+
+//Gets the index of the smallest size class that can hold size bytes
+static inline size_t getSizeClass(size_t size){
+    size_t sizeClass = 0;
+    while(sizeClass < POOL_CLASSES && ((size_t)1 << (sizeClass + POOL_MIN_CLASS)) < size){
+        sizeClass++;
+    }
+    return sizeClass;
+}
+
+bufferPool* initPool(){
+    bufferPool* pool = calloc(1, sizeof(bufferPool));
+    if(pool != NULL && pthread_mutex_init(&pool->lock, NULL) != 0){
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void* poolAcquire(bufferPool* pool, size_t size){
+    size_t sizeClass = getSizeClass(size);
+    poolHeader* header = NULL;
+    if(size <= POOL_SLAB_SIZE){
+        pthread_mutex_lock(&pool->lock);
+        header = slabAcquire(pool);
+        pthread_mutex_unlock(&pool->lock);
+        sizeClass = POOL_SLAB_CLASS;
+    }
+    else if(sizeClass < POOL_CLASSES){
+        struct sizeClass* c = pool->classes + sizeClass;
+        pthread_mutex_lock(&pool->lock);
+        if(c->count > 0){
+            c->count--;
+            header = c->free[c->count];
+        }
+        pthread_mutex_unlock(&pool->lock);
+        if(header == NULL){
+            header = malloc(sizeof(poolHeader) + ((size_t)1 << (sizeClass + POOL_MIN_CLASS)));
+        }
+    }
+    else{
+        header = malloc(sizeof(poolHeader) + size);
+    }
+    if(header == NULL){
+        return NULL;
+    }
+    header->sizeClass = sizeClass;
+    return header + 1;
+}
+
+void poolRelease(bufferPool* pool, void* buffer){
+    if(buffer == NULL){
+        return;
+    }
+    poolHeader* header = (poolHeader*)buffer - 1;
+    if(header->sizeClass == POOL_SLAB_CLASS){
+        pthread_mutex_lock(&pool->lock);
+        header->next = pool->small.free;
+        pool->small.free = header;
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+    if(header->sizeClass < POOL_CLASSES){
+        struct sizeClass* c = pool->classes + header->sizeClass;
+        pthread_mutex_lock(&pool->lock);
+        if(c->count < POOL_DEPTH){
+            c->free[c->count] = header;
+            c->count++;
+            header = NULL;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        if(header == NULL){
+            return;
+        }
+    }
+    free(header);
+}
+
+void freePool(bufferPool* pool){
+    if(pool != NULL){
+        for(int i = 0; i < POOL_CLASSES; i++){
+            for(size_t n = 0; n < pool->classes[i].count; n++){
+                free(pool->classes[i].free[n]);
+            }
+        }
+        poolHeader* slab = pool->small.slabs;
+        while(slab != NULL){
+            poolHeader* next = slab->next;
+            free(slab);
+            slab = next;
+        }
+        pthread_mutex_destroy(&pool->lock);
+        free(pool);
+    }
+}
@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include <pthread.h>
+
+//A pool of reusable buffers, sorted into size classes so that a released buffer can serve any later request of a similar size
+//Buffers can be acquired on one thread and released on another
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#define POOL_MIN_CLASS 12 //log2 of the size of the smallest class, so 4KB
+#define POOL_CLASSES 10 //number of size classes, so the biggest class holds 2MB buffers
+#define POOL_DEPTH 8 //maximum number of free buffers kept per size class
+#define POOL_SLAB_SIZE 256 //buffers up to this size are carved out of slabs, since a backed up pipeline holds many small packets at once
+#define POOL_SLAB_BUFFERS 256 //number of buffers in a slab
+
+typedef struct bufferPool bufferPool;
+
+struct bufferPool{
+    pthread_mutex_t lock;
+    struct sizeClass{
+        void* free[POOL_DEPTH]; //buffers ready to be handed out
+        size_t count;
+    } classes[POOL_CLASSES];
+    struct slabs{
+        void* free; //small buffers ready to be handed out, linked through their headers
+        void* slabs; //every slab allocated so far, linked through their first bytes. They are only freed by freePool
+    } small;
+};
+
+/*!
+ @brief Initializes an empty pool
+ @return the newly allocated pool, or NULL on error
+*/
+bufferPool* initPool();
+
+/*!
+ @brief Gets a buffer of at least the given size from the pool. The buffer contents are undefined
+ @param pool the pool to get the buffer from
+ @param size the minimum size of the buffer
+ @return the buffer, or NULL on error
+*/
+void* poolAcquire(bufferPool* pool, size_t size);
+
+/*!
+ @brief Gives a buffer acquired from the pool back to it
+ @param pool the pool the buffer was acquired from
+ @param buffer the buffer to give back, or NULL
+*/
+void poolRelease(bufferPool* pool, void* buffer);
+
+/*!
+ @brief Frees the pool alongside all the buffers it holds. Buffers that haven't been released aren't freed
+ @param pool the pool to free
+*/
+void freePool(bufferPool* pool);
+
+#endif
@@ -129,6 +129,86 @@ typedef struct nbt_node {
     } payload;
 } nbt_node;
 
+/*
+ * A read-only view of a tag that is still in its binary form, such as a tag
+ * within a network packet. Nothing is copied or allocated: the view points
+ * into the buffer, which must outlive it. An absent or malformed tag is a view
+ * of type TAG_INVALID, which every view function accepts.
+ */
+typedef struct nbt_view {
+    nbt_type type;
+    const char* name;       /* NOT NULL-terminated. NULL for list elements. */
+    uint16_t name_length;
+    const uint8_t* payload; /* the big endian payload, right after the name */
+    size_t length;          /* the size of the payload in bytes */
+} nbt_view;
+
+/*
+ * A node of a flat tree, which lives in one contiguous block of memory along
+ * with all the other nodes, names, strings and arrays of the tree. The
+ * children of a list or compound are a range of consecutive nodes, so there
+ * is no per node allocation to free, and walking the children doesn't chase
+ * any pointers. Flat trees are read-only once built.
+ */
+typedef struct nbt_flat_node {
+    nbt_type type;
+    const char* name; /* This may be NULL, just like in nbt_node. */
+
+    union { /* payload */
+        int8_t  tag_byte;
+        int16_t tag_short;
+        int32_t tag_int;
+        int64_t tag_long;
+        float   tag_float;
+        double  tag_double;
+
+        struct nbt_byte_array tag_byte_array;
+        struct nbt_int_array  tag_int_array;
+        struct nbt_long_array tag_long_array;
+
+        const char* tag_string;
+
+        /* The children are nodes[first] up to nodes[first + count - 1]. */
+        struct nbt_flat_range {
+            uint32_t first;
+            uint32_t count;
+        } tag_list,
+          tag_compound;
+    } payload;
+} nbt_flat_node;
+
+/*
+ * Compounds with at least this many children get their children indexed by
+ * name when the flat tree is built.
+ */
+#define NBT_FLAT_INDEX_MIN_CHILDREN 16
+
+/*
+ * A flat tree. nodes[0] is the root.
+ *
+ * `index' is an open addressing hash table over the children of the large
+ * compounds, keyed by the compound and the name of the child. A slot holds the
+ * position of the child in `nodes', or 0 if it's empty, since the root is
+ * never anyone's child. It has index_mask + 1 slots, or none at all if there
+ * is no large compound.
+ */
+typedef struct nbt_flat_tree {
+    nbt_flat_node* nodes;
+    size_t count;
+
+    const uint32_t* index;
+    size_t index_mask;
+} nbt_flat_tree;
+
+/* Walks over the children of a compound or the elements of a list view. */
+typedef struct nbt_view_iterator {
+    nbt_type parent;   /* TAG_INVALID once the iteration is over */
+    nbt_type element;  /* the type of the list elements */
+    int32_t remaining; /* the number of list elements left */
+    const uint8_t* cursor;
+    size_t length;     /* the bytes left from cursor to the end of the parent */
+} nbt_view_iterator;
+
                /***** High Level Loading/Saving Functions *****/
 
 /*
@@ -183,6 +263,22 @@ struct buffer nbt_dump_compressed(const nbt_node* tree,
  */
 nbt_node* nbt_parse(const void* memory, size_t length);
 
+/*
+ * Loads a NBT tree from the start of a block of memory that may go on past the
+ * end of the tree, such as a network packet, in a single pass. The number of
+ * bytes the tree took up is stored in `consumed'. A lone TAG_END is an absent
+ * tree: NULL is returned with errno set to NBT_OK and `consumed' set to 1. On
+ * any other error NULL is returned, errno is set and `consumed' is set to 0.
+ */
+nbt_node* nbt_parse_prefix(const void* memory, size_t length, size_t* consumed);
+
+/*
+ * Loads a single nameless payload of the given type from memory, such as the
+ * payload of a list element. The node takes ownership of `name', which may be
+ * NULL, and frees it if an error occurs.
+ */
+nbt_node* nbt_parse_payload(nbt_type type, char* name, const void* memory, size_t length);
+
 /*
  * Returns a NULL-terminated string as the ascii representation of the tree. If
  * an error occurs, NULL will be returned and errno will be set.
@@ -306,6 +402,104 @@ nbt_node* nbt_list_item(nbt_node* list, int n);
 
 /* TODO: More utilities as requests are made and patches contributed. */
 
+                         /***** View Functions *****/
+
+/*
+ * Opens a view of the tree at the start of a block of memory, which may go on
+ * past the end of the tree. The bytes the tree takes up are validated once and
+ * their number is stored in `consumed'. A lone TAG_END consumes 1 byte and
+ * gives an invalid view, as does malformed data, which consumes nothing.
+ */
+nbt_view nbt_view_open(const void* memory, size_t length, size_t* consumed);
+
+/* Starts iterating over the children of a compound or a list view. */
+nbt_view_iterator nbt_view_children(nbt_view view);
+
+/*
+ * Moves to the next child, storing it in `child'. Returns false once there
+ * are no more children.
+ */
+bool nbt_view_next(nbt_view_iterator* it, nbt_view* child);
+
+/*
+ * Returns the direct child of a compound view with the given name. Unlike
+ * nbt_find_by_name this doesn't search any deeper, so it never has to look at
+ * more than the compound's own entries.
+ */
+nbt_view nbt_view_find(nbt_view compound, const char* name);
+
+/*
+ * Follows a path of names separated by dots from a compound view, so that
+ * "a.b" is the child b of the child a. Unlike nbt_find_by_path the path
+ * doesn't start with the name of the view itself.
+ */
+nbt_view nbt_view_find_by_path(nbt_view view, const char* path);
+
+/*
+ * Typed getters. They return the value of a view of exactly that type, or the
+ * fallback for views of any other type, including invalid ones.
+ */
+int8_t  nbt_view_byte(nbt_view view, int8_t fallback);
+int16_t nbt_view_short(nbt_view view, int16_t fallback);
+int32_t nbt_view_int(nbt_view view, int32_t fallback);
+int64_t nbt_view_long(nbt_view view, int64_t fallback);
+float   nbt_view_float(nbt_view view, float fallback);
+double  nbt_view_double(nbt_view view, double fallback);
+
+/*
+ * Returns the characters of a string view, which are NOT NULL-terminated, and
+ * stores their number in `length'. Returns NULL for views of other types.
+ */
+const char* nbt_view_string(nbt_view view, size_t* length);
+
+/*
+ * Returns the number of elements of an array or a list view, or the number of
+ * bytes of a string view. Returns -1 for views of other types.
+ */
+int32_t nbt_view_length(nbt_view view);
+
+/*
+ * Builds a regular tree out of a view, for when the whole tag is needed after
+ * all. Returns NULL and sets errno on failure. Free it with nbt_free.
+ */
+nbt_node* nbt_view_materialize(nbt_view view);
+
+                       /***** Flat Tree Functions *****/
+
+/*
+ * Builds a flat tree in a single allocation. Returns NULL and sets errno on
+ * failure, or for an invalid view.
+ */
+nbt_flat_tree* nbt_flat_from_view(nbt_view view);
+
+/*
+ * Builds a flat tree out of the tree at the start of a block of memory, like
+ * nbt_parse_prefix does. A lone TAG_END returns NULL with errno set to NBT_OK.
+ */
+nbt_flat_tree* nbt_flat_parse(const void* memory, size_t length, size_t* consumed);
+
+/* Frees the whole tree at once. */
+void nbt_flat_free(nbt_flat_tree* tree);
+
+/*
+ * Returns the first child of a list or compound node and stores the number of
+ * children in `count'. Returns NULL and a count of 0 for any other node.
+ */
+const nbt_flat_node* nbt_flat_children(const nbt_flat_tree* tree, const nbt_flat_node* node, size_t* count);
+
+/*
+ * The flat counterparts of nbt_find_by_name and nbt_find_by_path. They search
+ * from `node', which is usually the root, and behave exactly like the former.
+ */
+const nbt_flat_node* nbt_flat_find_by_name(const nbt_flat_tree* tree, const nbt_flat_node* node, const char* name);
+const nbt_flat_node* nbt_flat_find_by_path(const nbt_flat_tree* tree, const nbt_flat_node* node, const char* path);
+
+/*
+ * Returns the first child of a compound with the given name, or NULL if there
+ * is none. This takes constant time for indexed compounds.
+ */
+const nbt_flat_node* nbt_flat_find_child(const nbt_flat_tree* tree, const nbt_flat_node* node, const char* name);
+
                       /***** Utility Functions *****/
 
 /* Returns true if the trees are identical. */
@@ -0,0 +1,580 @@
+#include "nbt.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A flat tree is built in two linear passes over the binary tag. The first one
+ * validates it, counts the nodes and the bytes of names, strings and arrays,
+ * and notes the number of children of every compound, so that the whole tree
+ * can be allocated at once. The second one fills the nodes in depth first,
+ * reserving a run of consecutive nodes for the children of a container before
+ * descending into them, which keeps siblings contiguous.
+ *
+ * The name index of the large compounds goes at the end of the same block and
+ * is filled in once all the nodes are, so lookups never modify the tree.
+ */
+
+#define MAX_FLAT_DEPTH 512 /* the same nesting limit nbt_view uses */
+
+struct flat_builder {
+    nbt_flat_tree* tree; /* NULL during the first pass */
+    size_t nodes;        /* the nodes counted, or reserved so far */
+    size_t bytes;
+    char* pool;
+
+    uint32_t* counts;    /* the number of children of every compound, in the order they start */
+    size_t compounds;
+    size_t capacity;
+
+    bool out_of_memory;
+};
+
+/* Everything in the pool is 8 byte aligned, so that it can hold long arrays. */
+static inline size_t pool_align(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+static inline uint16_t read_u16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t read_u32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t read_u64(const uint8_t* p)
+{
+    return ((uint64_t)read_u32(p) << 32) | read_u32(p + 4);
+}
+
+/* Copies `length' bytes into the pool as a NULL-terminated string. */
+static char* pool_string(struct flat_builder* b, const void* s, size_t length)
+{
+    char* ret = b->pool;
+
+    memcpy(ret, s, length);
+    ret[length] = '\0';
+
+    b->pool += pool_align(length + 1);
+    return ret;
+}
+
+/* Notes a compound during the first pass. Returns its index in counts. */
+static size_t push_compound(struct flat_builder* b)
+{
+    if(b->compounds == b->capacity)
+    {
+        size_t capacity = b->capacity == 0 ? 64 : b->capacity * 2;
+        uint32_t* counts = realloc(b->counts, capacity * sizeof *counts);
+        if(counts == NULL)
+        {
+            b->out_of_memory = true;
+            return SIZE_MAX;
+        }
+
+        b->counts = counts;
+        b->capacity = capacity;
+    }
+
+    b->counts[b->compounds] = 0;
+    return b->compounds++;
+}
+
+/*
+ * Returns the size of an array payload of `element' byte elements, or 0 if it
+ * runs past `length'. During the second pass it's copied into the pool.
+ */
+static size_t walk_array(struct flat_builder* b, nbt_flat_node* node, const uint8_t* p, size_t length, size_t element)
+{
+    if(length < 4) return 0;
+
+    int32_t count = (int32_t)read_u32(p);
+    if(count < 0 || (size_t)count > (length - 4) / element) return 0;
+
+    size_t size = pool_align((size_t)count * element);
+    const uint8_t* data = p + 4;
+
+    if(b->tree == NULL)
+    {
+        b->bytes += size;
+        return 4 + (size_t)count * element;
+    }
+
+    /* the arrays all share their layout, so any of them will do */
+    node->payload.tag_byte_array.length = count;
+    node->payload.tag_byte_array.data = (unsigned char*)b->pool;
+
+    if(element == 1)
+        memcpy(b->pool, data, (size_t)count);
+    else if(element == sizeof(int32_t))
+        for(int32_t i = 0; i < count; i++)
+            ((int32_t*)b->pool)[i] = (int32_t)read_u32(data + i * sizeof(int32_t));
+    else
+        for(int32_t i = 0; i < count; i++)
+            ((int64_t*)b->pool)[i] = (int64_t)read_u64(data + i * sizeof(int64_t));
+
+    b->pool += size;
+    return 4 + (size_t)count * element;
+}
+
+/*
+ * Walks over the payload of a tag of the given type. Returns the number of
+ * bytes it takes up, or 0 if it runs past `length', is malformed or if we run
+ * out of memory. During the second pass `node' is filled in.
+ */
+static size_t walk(struct flat_builder* b, nbt_flat_node* node, nbt_type type,
+                   const uint8_t* name, uint16_t name_length,
+                   const uint8_t* p, size_t length, int depth)
+{
+    size_t size = 0;
+
+    if(depth > MAX_FLAT_DEPTH) return 0;
+
+    if(b->tree == NULL)
+    {
+        b->nodes++;
+        if(name != NULL) b->bytes += pool_align((size_t)name_length + 1);
+    }
+    else
+    {
+        node->type = type;
+        node->name = name != NULL ? pool_string(b, name, name_length) : NULL;
+    }
+
+    switch(type)
+    {
+    case TAG_BYTE:   size = 1; break;
+    case TAG_SHORT:  size = 2; break;
+    case TAG_INT:    size = 4; break;
+    case TAG_LONG:   size = 8; break;
+    case TAG_FLOAT:  size = 4; break;
+    case TAG_DOUBLE: size = 8; break;
+
+    case TAG_BYTE_ARRAY: return walk_array(b, node, p, length, 1);
+    case TAG_INT_ARRAY:  return walk_array(b, node, p, length, sizeof(int32_t));
+    case TAG_LONG_ARRAY: return walk_array(b, node, p, length, sizeof(int64_t));
+
+    case TAG_STRING:
+        if(length < 2) return 0;
+        size = 2 + read_u16(p);
+        if(size > length) return 0;
+
+        if(b->tree == NULL)
+            b->bytes += pool_align(size - 2 + 1);
+        else
+            node->payload.tag_string = pool_string(b, p + 2, size - 2);
+        return size;
+
+    case TAG_LIST:
+    {
+        if(length < 5) return 0;
+
+        nbt_type element = (nbt_type)p[0];
+        int32_t count = (int32_t)read_u32(p + 1);
+        size_t first = b->nodes;
+        size = 5;
+
+        if(count < 0) count = 0; /* empty lists may claim any element type */
+
+        if(b->tree != NULL)
+        {
+            node->payload.tag_list.first = (uint32_t)first;
+            node->payload.tag_list.count = (uint32_t)count;
+            b->nodes += (size_t)count;
+        }
+
+        for(int32_t i = 0; i < count; i++)
+        {
+            nbt_flat_node* child = b->tree != NULL ? b->tree->nodes + first + i : NULL;
+
+            size_t s = walk(b, child, element, NULL, 0, p + size, length - size, depth + 1);
+            if(s == 0) return 0;
+            size += s;
+        }
+        return size;
+    }
+
+    case TAG_COMPOUND:
+    {
+        size_t first = b->nodes;
+        size_t index = 0;
+        uint32_t count = 0;
+
+        if(b->tree == NULL)
+        {
+            if((index = push_compound(b)) == SIZE_MAX) return 0;
+        }
+        else
+        {
+            count = b->counts[b->compounds++];
+            node->payload.tag_compound.first = (uint32_t)first;
+            node->payload.tag_compound.count = count;
+            b->nodes += count;
+        }
+
+        for(uint32_t i = 0; ; i++)
+        {
+            if(size >= length) return 0;
+            if(p[size] == TAG_INVALID) break;
+
+            if(length - size < 3) return 0;
+            nbt_type child_type = (nbt_type)p[size];
+            uint16_t child_name_length = read_u16(p + size + 1);
+            if(child_type > TAG_LONG_ARRAY || length - size - 3 < child_name_length) return 0;
+
+            const uint8_t* child_name = p + size + 3;
+            size += 3 + (size_t)child_name_length;
+
+            nbt_flat_node* child = b->tree != NULL ? b->tree->nodes + first + i : NULL;
+
+            size_t s = walk(b, child, child_type, child_name, child_name_length, p + size, length - size, depth + 1);
+            if(s == 0) return 0;
+            size += s;
+
+            if(b->tree == NULL) b->counts[index]++;
+        }
+        return size + 1;
+    }
+
+    default:
+        return 0;
+    }
+
+    if(size > length) return 0;
+
+    if(b->tree != NULL)
+    {
+        switch(type)
+        {
+        case TAG_BYTE:   node->payload.tag_byte   = (int8_t)p[0];              break;
+        case TAG_SHORT:  node->payload.tag_short  = (int16_t)read_u16(p);      break;
+        case TAG_INT:    node->payload.tag_int    = (int32_t)read_u32(p);      break;
+        case TAG_LONG:   node->payload.tag_long   = (int64_t)read_u64(p);      break;
+        case TAG_FLOAT:  { uint32_t bits = read_u32(p); memcpy(&node->payload.tag_float, &bits, sizeof bits); break; }
+        case TAG_DOUBLE: { uint64_t bits = read_u64(p); memcpy(&node->payload.tag_double, &bits, sizeof bits); break; }
+        default: break;
+        }
+    }
+
+    return size;
+}
+
+/* FNV-1a over the name, mixed with the position of the compound. */
+static size_t index_hash(size_t parent, const char* name, size_t length)
+{
+    uint32_t hash = 2166136261u;
+
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash ^ (uint32_t)(parent * 2654435769u);
+}
+
+/* Returns the number of slots the index needs, a power of two, or 0. */
+static size_t index_size(const struct flat_builder* b)
+{
+    size_t children = 0;
+    size_t size = 1;
+
+    for(size_t i = 0; i < b->compounds; i++)
+        if(b->counts[i] >= NBT_FLAT_INDEX_MIN_CHILDREN)
+            children += b->counts[i];
+
+    if(children == 0) return 0;
+
+    /* keep it at most half full, so that probes stay short */
+    while(size < children * 2)
+        size *= 2;
+
+    return size;
+}
+
+/*
+ * Adds the children of every large compound to the index. Children sharing a
+ * name end up in the index in the order they appear in the compound.
+ */
+static void index_fill(nbt_flat_tree* tree, uint32_t* index)
+{
+    memset(index, 0, (tree->index_mask + 1) * sizeof *index);
+
+    for(size_t i = 0; i < tree->count; i++)
+    {
+        const nbt_flat_node* node = tree->nodes + i;
+
+        if(node->type != TAG_COMPOUND || node->payload.tag_compound.count < NBT_FLAT_INDEX_MIN_CHILDREN)
+            continue;
+
+        for(uint32_t c = 0; c < node->payload.tag_compound.count; c++)
+        {
+            uint32_t child = node->payload.tag_compound.first + c;
+            const char* name = tree->nodes[child].name;
+            size_t slot = index_hash(i, name, strlen(name)) & tree->index_mask;
+
+            while(index[slot] != 0)
+                slot = (slot + 1) & tree->index_mask;
+
+            index[slot] = child;
+        }
+    }
+}
+
+/* Builds a flat tree out of a single payload, storing its size in `size'. */
+static nbt_flat_tree* build(nbt_type type, const uint8_t* name, uint16_t name_length,
+                            const uint8_t* payload, size_t length, size_t* size)
+{
+    struct flat_builder b = { NULL, 0, 0, NULL, NULL, 0, 0, false };
+
+    *size = walk(&b, NULL, type, name, name_length, payload, length, 0);
+
+    if(*size == 0 || b.nodes > UINT32_MAX)
+    {
+        errno = b.out_of_memory ? NBT_EMEM : NBT_ERR;
+        free(b.counts);
+        return NULL;
+    }
+
+    size_t header = pool_align(sizeof(nbt_flat_tree));
+    size_t slots = index_size(&b);
+    nbt_flat_tree* tree = malloc(header + b.nodes * sizeof(nbt_flat_node) + b.bytes + slots * sizeof(uint32_t));
+
+    if(tree == NULL)
+    {
+        free(b.counts);
+        errno = NBT_EMEM;
+        return NULL;
+    }
+
+    tree->nodes = (nbt_flat_node*)((char*)tree + header);
+    tree->count = b.nodes;
+
+    b.tree = tree;
+    b.pool = (char*)(tree->nodes + b.nodes);
+    b.nodes = 1; /* the root */
+    b.compounds = 0;
+
+    walk(&b, tree->nodes, type, name, name_length, payload, length, 0);
+
+    free(b.counts);
+
+    /* the pool ends 8 byte aligned, right where the index starts */
+    tree->index = NULL;
+    tree->index_mask = 0;
+
+    if(slots > 0)
+    {
+        uint32_t* index = (uint32_t*)((char*)(tree->nodes + tree->count) + b.bytes);
+
+        tree->index_mask = slots - 1;
+        index_fill(tree, index);
+        tree->index = index;
+    }
+
+    errno = NBT_OK;
+    return tree;
+}
+
+nbt_flat_tree* nbt_flat_from_view(nbt_view view)
+{
+    size_t size;
+
+    if(view.type == TAG_INVALID)
+    {
+        errno = NBT_ERR;
+        return NULL;
+    }
+
+    return build(view.type, (const uint8_t*)view.name, view.name_length, view.payload, view.length, &size);
+}
+
+nbt_flat_tree* nbt_flat_parse(const void* memory, size_t length, size_t* consumed)
+{
+    const uint8_t* p = memory;
+    size_t size;
+
+    *consumed = 0;
+
+    if(length > 0 && p[0] == TAG_INVALID)
+    {
+        /* a lone TAG_END is an absent tag rather than an error */
+        *consumed = 1;
+        errno = NBT_OK;
+        return NULL;
+    }
+
+    if(length < 3 || length - 3 < read_u16(p + 1))
+    {
+        errno = NBT_ERR;
+        return NULL;
+    }
+
+    uint16_t name_length = read_u16(p + 1);
+    size_t header = 3 + (size_t)name_length;
+
+    nbt_flat_tree* tree = build((nbt_type)p[0], p + 3, name_length, p + header, length - header, &size);
+    if(tree != NULL)
+        *consumed = header + size;
+
+    return tree;
+}
+
+void nbt_flat_free(nbt_flat_tree* tree)
+{
+    free(tree);
+}
+
+const nbt_flat_node* nbt_flat_children(const nbt_flat_tree* tree, const nbt_flat_node* node, size_t* count)
+{
+    if(node == NULL || (node->type != TAG_LIST && node->type != TAG_COMPOUND))
+    {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = node->payload.tag_compound.count;
+    return tree->nodes + node->payload.tag_compound.first;
+}
+
+static bool names_are_equal(const nbt_flat_node* node, const char* name)
+{
+    if(name == NULL || node->name == NULL)
+        return name == node->name;
+
+    return strcmp(node->name, name) == 0;
+}
+
+static inline bool is_indexed(const nbt_flat_tree* tree, const nbt_flat_node* node)
+{
+    return tree->index != NULL && node->type == TAG_COMPOUND
+        && node->payload.tag_compound.count >= NBT_FLAT_INDEX_MIN_CHILDREN;
+}
+
+/*
+ * Returns the next child of an indexed compound named by the first `length'
+ * characters of `name', probing from `slot', which starts out as the hash of
+ * the name. Returns NULL once there are no more.
+ */
+static const nbt_flat_node* index_next(const nbt_flat_tree* tree, const nbt_flat_node* node,
+                                       const char* name, size_t length, size_t* slot)
+{
+    uint32_t first = node->payload.tag_compound.first;
+    uint32_t count = node->payload.tag_compound.count;
+    uint32_t child;
+
+    while((child = tree->index[*slot]) != 0)
+    {
+        *slot = (*slot + 1) & tree->index_mask;
+
+        const char* child_name = tree->nodes[child].name;
+
+        if(child - first < count && strncmp(child_name, name, length) == 0 && child_name[length] == '\0')
+            return tree->nodes + child;
+    }
+
+    return NULL;
+}
+
+const nbt_flat_node* nbt_flat_find_child(const nbt_flat_tree* tree, const nbt_flat_node* node, const char* name)
+{
+    size_t count;
+
+    if(node == NULL || node->type != TAG_COMPOUND) return NULL;
+
+    if(is_indexed(tree, node))
+    {
+        size_t length = strlen(name);
+        size_t slot = index_hash((size_t)(node - tree->nodes), name, length) & tree->index_mask;
+
+        return index_next(tree, node, name, length, &slot);
+    }
+
+    const nbt_flat_node* children = nbt_flat_children(tree, node, &count);
+
+    for(size_t i = 0; i < count; i++)
+        if(names_are_equal(children + i, name))
+            return children + i;
+
+    return NULL;
+}
+
+const nbt_flat_node* nbt_flat_find_by_name(const nbt_flat_tree* tree, const nbt_flat_node* node, const char* name)
+{
+    size_t count;
+
+    if(node == NULL)                   return NULL;
+    if(names_are_equal(node, name))    return node;
+
+    const nbt_flat_node* children = nbt_flat_children(tree, node, &count);
+
+    for(size_t i = 0; i < count; i++)
+    {
+        const nbt_flat_node* found;
+
+        if((found = nbt_flat_find_by_name(tree, children + i, name)))
+            return found;
+    }
+
+    return NULL;
+}
+
+const nbt_flat_node* nbt_flat_find_by_path(const nbt_flat_tree* tree, const nbt_flat_node* node, const char* path)
+{
+    size_t count;
+
+    if(node == NULL) return NULL;
+
+    /* The end of the "current_name" piece. */
+    const char* dot = strchr(path, '.');
+    size_t e = dot != NULL ? (size_t)(dot - path) : strlen(path);
+
+    if(node->name == NULL)
+    {
+        if(e != 0) return NULL;
+    }
+    else if(strncmp(path, node->name, e) != 0 || node->name[e] != '\0')
+    {
+        return NULL;
+    }
+
+    if(path[e] == '\0') return node;
+
+    const char* rest = path + e + 1;
+
+    if(is_indexed(tree, node))
+    {
+        /* only the children named by the next piece can match */
+        const char* next = strchr(rest, '.');
+        size_t length = next != NULL ? (size_t)(next - rest) : strlen(rest);
+        size_t slot = index_hash((size_t)(node - tree->nodes), rest, length) & tree->index_mask;
+        const nbt_flat_node* child;
+
+        while((child = index_next(tree, node, rest, length, &slot)) != NULL)
+        {
+            const nbt_flat_node* r;
+
+            if((r = nbt_flat_find_by_path(tree, child, rest)) != NULL)
+                return r;
+        }
+
+        return NULL;
+    }
+
+    const nbt_flat_node* children = nbt_flat_children(tree, node, &count);
+
+    for(size_t i = 0; i < count; i++)
+    {
+        const nbt_flat_node* r;
+
+        if((r = nbt_flat_find_by_path(tree, children + i, rest)) != NULL)
+            return r;
+    }
+
+    return NULL;
+}
@@ -156,6 +156,7 @@ static nbt_node* parse_named_tag(const char** memory, size_t* length)
   READ_GENERIC(&type, sizeof type, memscan, goto parse_error);
 
   name = read_string(memory, length);
+  if(name == NULL) goto parse_error;
 
   nbt_node* ret = parse_unnamed_tag((nbt_type)type, name, memory, length);
   if(ret == NULL) goto parse_error;
@@ -462,6 +463,48 @@ nbt_node* nbt_parse(const void* mem, size_t len)
     return parse_named_tag(memory, length);
 }
 
+nbt_node* nbt_parse_prefix(const void* mem, size_t len, size_t* consumed)
+{
+    errno = NBT_OK;
+    *consumed = 0;
+
+    if(len == 0)
+    {
+        errno = NBT_ERR;
+        return NULL;
+    }
+
+    /* a lone TAG_END is how the protocol sends an absent tree */
+    if(*(const uint8_t*)mem == TAG_INVALID)
+    {
+        *consumed = 1;
+        return NULL;
+    }
+
+    const char* memory = mem;
+    size_t length = len;
+
+    nbt_node* ret = parse_named_tag(&memory, &length);
+    if(ret != NULL)
+        *consumed = len - length;
+
+    return ret;
+}
+
+nbt_node* nbt_parse_payload(nbt_type type, char* name, const void* mem, size_t len)
+{
+    errno = NBT_OK;
+
+    const char* memory = mem;
+    size_t length = len;
+
+    nbt_node* ret = parse_unnamed_tag(type, name, &memory, &length);
+    if(ret == NULL)
+        free(name);
+
+    return ret;
+}
+
 /* spaces, not tabs ;) */
 static void indent(struct buffer* b, size_t amount)
 {
@@ -0,0 +1,340 @@
+#include "nbt.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Views never copy anything. Every accessor decodes the big endian bytes it
+ * needs straight from the buffer, and finding a child skips over its elder
+ * siblings without parsing them.
+ */
+
+#define MAX_VIEW_DEPTH 512 /* the same nesting limit the game enforces */
+
+static const nbt_view invalid_view = { TAG_INVALID, NULL, 0, NULL, 0 };
+
+static inline uint16_t read_u16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t read_u32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t read_u64(const uint8_t* p)
+{
+    return ((uint64_t)read_u32(p) << 32) | read_u32(p + 4);
+}
+
+/*
+ * Returns the number of bytes the payload of the given type takes up, or 0 if
+ * it runs past `length' or is malformed. No payload is ever 0 bytes long.
+ */
+static size_t payload_size(nbt_type type, const uint8_t* p, size_t length, int depth);
+
+/* Reads a compound entry header. Returns the entry with it's payload bounds set. */
+static nbt_view read_entry(const uint8_t* p, size_t length)
+{
+    nbt_view ret = invalid_view;
+
+    if(length < 1 || p[0] == TAG_INVALID || p[0] > TAG_LONG_ARRAY) return ret;
+    if(length < 3) return ret;
+
+    uint16_t name_length = read_u16(p + 1);
+    if(length < 3 + (size_t)name_length) return ret;
+
+    ret.type = (nbt_type)p[0];
+    ret.name = (const char*)p + 3;
+    ret.name_length = name_length;
+    ret.payload = p + 3 + name_length;
+    ret.length = length - 3 - name_length;
+    return ret;
+}
+
+static size_t array_size(const uint8_t* p, size_t length, size_t element)
+{
+    if(length < 4) return 0;
+
+    int32_t count = (int32_t)read_u32(p);
+    if(count < 0 || (size_t)count > (length - 4) / element) return 0;
+
+    return 4 + (size_t)count * element;
+}
+
+static size_t payload_size(nbt_type type, const uint8_t* p, size_t length, int depth)
+{
+    size_t size = 0;
+
+    if(depth > MAX_VIEW_DEPTH) return 0;
+
+    switch(type)
+    {
+    case TAG_BYTE:   size = 1; break;
+    case TAG_SHORT:  size = 2; break;
+    case TAG_INT:    size = 4; break;
+    case TAG_LONG:   size = 8; break;
+    case TAG_FLOAT:  size = 4; break;
+    case TAG_DOUBLE: size = 8; break;
+
+    case TAG_BYTE_ARRAY: return array_size(p, length, 1);
+    case TAG_INT_ARRAY:  return array_size(p, length, 4);
+    case TAG_LONG_ARRAY: return array_size(p, length, 8);
+
+    case TAG_STRING:
+        if(length < 2) return 0;
+        size = 2 + read_u16(p);
+        break;
+
+    case TAG_LIST:
+    {
+        if(length < 5) return 0;
+
+        nbt_type element = (nbt_type)p[0];
+        int32_t count = (int32_t)read_u32(p + 1);
+        size = 5;
+
+        if(count <= 0) break; /* empty lists may claim any element type */
+
+        for(int32_t i = 0; i < count; i++)
+        {
+            size_t s = payload_size(element, p + size, length - size, depth + 1);
+            if(s == 0) return 0;
+            size += s;
+        }
+        return size;
+    }
+
+    case TAG_COMPOUND:
+        while(true)
+        {
+            if(size >= length) return 0;
+            if(p[size] == TAG_INVALID) return size + 1;
+
+            nbt_view entry = read_entry(p + size, length - size);
+            if(entry.type == TAG_INVALID) return 0;
+
+            size_t s = payload_size(entry.type, entry.payload, entry.length, depth + 1);
+            if(s == 0) return 0;
+
+            size = (size_t)(entry.payload - p) + s;
+        }
+
+    default:
+        return 0;
+    }
+
+    return size <= length ? size : 0;
+}
+
+nbt_view nbt_view_open(const void* memory, size_t length, size_t* consumed)
+{
+    *consumed = 0;
+
+    if(length > 0 && *(const uint8_t*)memory == TAG_INVALID)
+    {
+        *consumed = 1;
+        return invalid_view;
+    }
+
+    nbt_view ret = read_entry(memory, length);
+    if(ret.type == TAG_INVALID) return invalid_view;
+
+    size_t size = payload_size(ret.type, ret.payload, ret.length, 0);
+    if(size == 0) return invalid_view;
+
+    ret.length = size;
+    *consumed = (size_t)(ret.payload - (const uint8_t*)memory) + size;
+    return ret;
+}
+
+nbt_view_iterator nbt_view_children(nbt_view view)
+{
+    nbt_view_iterator it = { TAG_INVALID, TAG_INVALID, 0, NULL, 0 };
+
+    if(view.type == TAG_COMPOUND)
+    {
+        it.parent = TAG_COMPOUND;
+        it.cursor = view.payload;
+        it.length = view.length;
+    }
+    else if(view.type == TAG_LIST && view.length >= 5)
+    {
+        it.parent = TAG_LIST;
+        it.element = (nbt_type)view.payload[0];
+        it.remaining = (int32_t)read_u32(view.payload + 1);
+        it.cursor = view.payload + 5;
+        it.length = view.length - 5;
+    }
+
+    return it;
+}
+
+bool nbt_view_next(nbt_view_iterator* it, nbt_view* child)
+{
+    nbt_view next = invalid_view;
+
+    if(it->parent == TAG_COMPOUND)
+    {
+        next = read_entry(it->cursor, it->length);
+    }
+    else if(it->parent == TAG_LIST && it->remaining > 0)
+    {
+        next.type = it->element;
+        next.payload = it->cursor;
+        next.length = it->length;
+        it->remaining--;
+    }
+
+    if(next.type == TAG_INVALID) goto end;
+
+    size_t size = payload_size(next.type, next.payload, next.length, 0);
+    if(size == 0) goto end;
+
+    next.length = size;
+    it->length -= (size_t)(next.payload - it->cursor) + size;
+    it->cursor = next.payload + size;
+
+    *child = next;
+    return true;
+
+end:
+    /* a TAG_END, the end of a list or malformed data. Either way we're done */
+    it->parent = TAG_INVALID;
+    return false;
+}
+
+nbt_view nbt_view_find(nbt_view compound, const char* name)
+{
+    size_t name_length = strlen(name);
+    nbt_view child;
+
+    if(compound.type != TAG_COMPOUND) return invalid_view;
+
+    nbt_view_iterator it = nbt_view_children(compound);
+    while(nbt_view_next(&it, &child))
+        if(child.name_length == name_length && memcmp(child.name, name, name_length) == 0)
+            return child;
+
+    return invalid_view;
+}
+
+nbt_view nbt_view_find_by_path(nbt_view view, const char* path)
+{
+    char name[256];
+
+    while(*path != '\0' && view.type != TAG_INVALID)
+    {
+        const char* dot = strchr(path, '.');
+        size_t length = dot != NULL ? (size_t)(dot - path) : strlen(path);
+
+        if(length >= sizeof name) return invalid_view;
+
+        memcpy(name, path, length);
+        name[length] = '\0';
+
+        view = nbt_view_find(view, name);
+        path += dot != NULL ? length + 1 : length;
+    }
+
+    return view;
+}
+
+int8_t nbt_view_byte(nbt_view view, int8_t fallback)
+{
+    return view.type == TAG_BYTE ? (int8_t)view.payload[0] : fallback;
+}
+
+int16_t nbt_view_short(nbt_view view, int16_t fallback)
+{
+    return view.type == TAG_SHORT ? (int16_t)read_u16(view.payload) : fallback;
+}
+
+int32_t nbt_view_int(nbt_view view, int32_t fallback)
+{
+    return view.type == TAG_INT ? (int32_t)read_u32(view.payload) : fallback;
+}
+
+int64_t nbt_view_long(nbt_view view, int64_t fallback)
+{
+    return view.type == TAG_LONG ? (int64_t)read_u64(view.payload) : fallback;
+}
+
+float nbt_view_float(nbt_view view, float fallback)
+{
+    if(view.type != TAG_FLOAT) return fallback;
+
+    uint32_t bits = read_u32(view.payload);
+    float ret;
+    memcpy(&ret, &bits, sizeof ret);
+    return ret;
+}
+
+double nbt_view_double(nbt_view view, double fallback)
+{
+    if(view.type != TAG_DOUBLE) return fallback;
+
+    uint64_t bits = read_u64(view.payload);
+    double ret;
+    memcpy(&ret, &bits, sizeof ret);
+    return ret;
+}
+
+const char* nbt_view_string(nbt_view view, size_t* length)
+{
+    if(view.type != TAG_STRING)
+    {
+        *length = 0;
+        return NULL;
+    }
+
+    *length = read_u16(view.payload);
+    return (const char*)view.payload + 2;
+}
+
+int32_t nbt_view_length(nbt_view view)
+{
+    switch(view.type)
+    {
+    case TAG_BYTE_ARRAY:
+    case TAG_INT_ARRAY:
+    case TAG_LONG_ARRAY:
+        return (int32_t)read_u32(view.payload);
+    case TAG_LIST:
+    {
+        int32_t count = (int32_t)read_u32(view.payload + 1);
+        return count > 0 ? count : 0;
+    }
+    case TAG_STRING:
+        return read_u16(view.payload);
+    default:
+        return -1;
+    }
+}
+
+nbt_node* nbt_view_materialize(nbt_view view)
+{
+    char* name = NULL;
+
+    if(view.type == TAG_INVALID)
+    {
+        errno = NBT_ERR;
+        return NULL;
+    }
+
+    if(view.name != NULL)
+    {
+        if((name = malloc(view.name_length + 1)) == NULL)
+        {
+            errno = NBT_EMEM;
+            return NULL;
+        }
+
+        memcpy(name, view.name, view.name_length);
+        name[view.name_length] = '\0';
+    }
+
+    return nbt_parse_payload(view.type, name, view.payload, view.length);
+}
@@ -0,0 +1,230 @@
+#include "chunkDecoderMc.h"
+#include "gamestateMc.h"
+
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+
+/*!
+ @struct chunkJob
+ @brief A single submitted chunk packet
+ @param x the x coordinate of the chunk
+ @param z the z coordinate of the chunk
+ @param minY the lowest block y coordinate of the dimension the chunk is in, copied since the dimension may change before the job is decoded
+ @param height the height of that dimension
+ @param data a copy of the packet payload, freed once decoded
+ @param size the size of the payload
+ @param result the decoded chunk
+ @param status what decodeChunk returned
+ @param done set once a worker has decoded the packet
+*/
+struct chunkJob{
+    int32_t x;
+    int32_t z;
+    int32_t minY;
+    int32_t height;
+    byte* data;
+    size_t size;
+    chunk* result;
+    int status;
+    bool done;
+};
+
+struct chunkDecoder{
+    struct chunkJob ring[CHUNK_DECODER_DEPTH];
+    size_t head; //next job to be taken, only advanced by the gamestate thread
+    size_t next; //next job to be claimed by a worker
+    size_t tail; //next job to be submitted, only advanced by the gamestate thread
+    bool running;
+    pthread_mutex_t lock;
+    pthread_cond_t jobReady; //a job was submitted or the decoder is stopping
+    pthread_cond_t jobDone; //a job was decoded
+    pthread_t threads[MAX_DECODER_THREADS];
+    int threadCount;
+    const struct gameVersion* version;
+    uint64_t submitted;
+    uint64_t failed;
+    uint64_t stalls;
+};
+
+//Private functions
+
+/*!
+ @brief The worker thread. Claims jobs in order and decodes them until the decoder is stopped
+ @param arg the chunkDecoder
+ @return NULL
+*/
+static void* decoderWorker(void* arg);
+
+/*!
+ @brief Stops the worker threads
+ @param decoder the decoder
+ @return 0 on success, -1 if a thread couldn't be joined
+*/
+static int stopWorkers(struct chunkDecoder* decoder);
+
+struct chunkDecoder* initChunkDecoder(const struct gameVersion* version, int threads){
+    if(threads < 1 || threads > MAX_DECODER_THREADS){
+        errno = EINVAL;
+        return NULL;
+    }
+    struct chunkDecoder* decoder = calloc(1, sizeof(struct chunkDecoder));
+    if(decoder == NULL){
+        return NULL;
+    }
+    decoder->version = version;
+    decoder->running = true;
+    pthread_mutex_init(&decoder->lock, NULL);
+    pthread_cond_init(&decoder->jobReady, NULL);
+    pthread_cond_init(&decoder->jobDone, NULL);
+    for(; decoder->threadCount < threads; decoder->threadCount++){
+        if(pthread_create(decoder->threads + decoder->threadCount, NULL, decoderWorker, decoder) != 0){
+            freeChunkDecoder(decoder);
+            return NULL;
+        }
+    }
+    return decoder;
+}
+
+int submitChunk(struct chunkDecoder* decoder, int32_t chunkX, int32_t chunkZ, int32_t minY, int32_t height, const packet* p){
+    if(chunkDecoderFull(decoder)){
+        errno = EAGAIN;
+        return -1;
+    }
+    byte* data = malloc(p->size);
+    if(data == NULL){
+        return -1;
+    }
+    memcpy(data, p->data, p->size);
+    pthread_mutex_lock(&decoder->lock);
+    struct chunkJob* job = decoder->ring + (decoder->tail & (CHUNK_DECODER_DEPTH - 1));
+    job->x = chunkX;
+    job->z = chunkZ;
+    job->minY = minY;
+    job->height = height;
+    job->data = data;
+    job->size = p->size;
+    job->result = NULL;
+    job->status = 0;
+    job->done = false;
+    decoder->tail++;
+    decoder->submitted++;
+    pthread_cond_signal(&decoder->jobReady);
+    pthread_mutex_unlock(&decoder->lock);
+    return 0;
+}
+
+bool chunkDecoderFull(const struct chunkDecoder* decoder){
+    return decoder->tail - decoder->head == CHUNK_DECODER_DEPTH;
+}
+
+int takeDecodedChunk(struct chunkDecoder* decoder, bool wait, struct chunk** out){
+    *out = NULL;
+    if(decoder->head == decoder->tail){
+        return 1;
+    }
+    struct chunkJob* job = decoder->ring + (decoder->head & (CHUNK_DECODER_DEPTH - 1));
+    pthread_mutex_lock(&decoder->lock);
+    if(!job->done){
+        if(!wait){
+            pthread_mutex_unlock(&decoder->lock);
+            return 1;
+        }
+        decoder->stalls++;
+        while(!job->done){
+            pthread_cond_wait(&decoder->jobDone, &decoder->lock);
+        }
+    }
+    decoder->head++;
+    int status = job->status;
+    *out = job->result;
+    job->result = NULL;
+    if(status != 0){
+        decoder->failed++;
+    }
+    pthread_mutex_unlock(&decoder->lock);
+    return status;
+}
+
+size_t pendingChunkDepth(const struct chunkDecoder* decoder, int32_t chunkX, int32_t chunkZ){
+    //searching backwards finds the last packet for the chunk, which is the one that has to be waited for
+    for(size_t i = decoder->tail; i != decoder->head; i--){
+        const struct chunkJob* job = decoder->ring + ((i - 1) & (CHUNK_DECODER_DEPTH - 1));
+        if(job->x == chunkX && job->z == chunkZ){
+            return i - decoder->head;
+        }
+    }
+    return 0;
+}
+
+struct chunkDecoderStats getChunkDecoderStats(const struct chunkDecoder* decoder){
+    struct chunkDecoderStats stats = {};
+    stats.pending = decoder->tail - decoder->head;
+    stats.submitted = decoder->submitted;
+    stats.failed = decoder->failed;
+    stats.stalls = decoder->stalls;
+    return stats;
+}
+
+int freeChunkDecoder(struct chunkDecoder* decoder){
+    int res = stopWorkers(decoder);
+    //the workers finish the job they are on before exiting, so nothing is in use anymore
+    for(size_t i = decoder->head; i != decoder->tail; i++){
+        struct chunkJob* job = decoder->ring + (i & (CHUNK_DECODER_DEPTH - 1));
+        free(job->data);
+        if(job->result != NULL){
+            freeChunk(job->result);
+        }
+    }
+    pthread_mutex_destroy(&decoder->lock);
+    pthread_cond_destroy(&decoder->jobReady);
+    pthread_cond_destroy(&decoder->jobDone);
+    free(decoder);
+    return res;
+}
+
+static void* decoderWorker(void* arg){
+    struct chunkDecoder* decoder = arg;
+    pthread_mutex_lock(&decoder->lock);
+    while(true){
+        while(decoder->running && decoder->next == decoder->tail){
+            pthread_cond_wait(&decoder->jobReady, &decoder->lock);
+        }
+        if(!decoder->running){
+            break;
+        }
+        //the job can't be reused until it's taken, and it can't be taken until it's done
+        struct chunkJob* job = decoder->ring + (decoder->next++ & (CHUNK_DECODER_DEPTH - 1));
+        byte* data = job->data;
+        size_t size = job->size;
+        int32_t minY = job->minY;
+        int32_t height = job->height;
+        pthread_mutex_unlock(&decoder->lock);
+        chunk* result = NULL;
+        int status = decodeChunk(data, size, &result, minY, height, decoder->version);
+        free(data);
+        pthread_mutex_lock(&decoder->lock);
+        job->data = NULL;
+        job->result = result;
+        job->status = status;
+        job->done = true;
+        pthread_cond_signal(&decoder->jobDone);
+    }
+    pthread_mutex_unlock(&decoder->lock);
+    return NULL;
+}
+
+static int stopWorkers(struct chunkDecoder* decoder){
+    pthread_mutex_lock(&decoder->lock);
+    decoder->running = false;
+    pthread_cond_broadcast(&decoder->jobReady);
+    pthread_mutex_unlock(&decoder->lock);
+    int res = 0;
+    for(int i = 0; i < decoder->threadCount; i++){
+        if(pthread_join(decoder->threads[i], NULL) != 0){
+            res = -1;
+        }
+    }
+    decoder->threadCount = 0;
+    return res;
+}
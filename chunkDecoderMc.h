@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "mcTypes.h"
+
+//Worker pool that decodes chunk packets into detached chunks in parallel, and hands them back in the order they were submitted
+
+#ifndef CHUNK_DECODER_MC
+#define CHUNK_DECODER_MC
+
+#define CHUNK_DECODER_DEPTH 256 //maximum number of chunk packets waiting to be decoded or published, must be a power of 2
+#define MAX_DECODER_THREADS 64
+
+struct chunk;
+struct gameVersion;
+
+/*Chunk decoder note
+The gamestate thread submits chunk packets at the tail of a ring and takes decoded chunks from it's head, so chunks come out in packet order.
+Workers claim the jobs between head and tail one by one, and decode them without holding the lock.
+Only the gamestate thread touches the job coordinates and the head and tail indexes, so it can search the pending jobs without locking
+*/
+
+/*!
+ @struct chunkDecoderStats
+ @brief Counters for measuring how the chunk decoder keeps up
+ @param pending the number of chunk packets submitted but not yet taken
+ @param submitted the number of chunk packets submitted so far
+ @param failed the number of chunk packets that failed to decode
+ @param stalls the number of times the gamestate thread had to wait for a chunk to be decoded
+*/
+struct chunkDecoderStats{
+    size_t pending;
+    uint64_t submitted;
+    uint64_t failed;
+    uint64_t stalls;
+};
+
+/*!
+ @brief Starts the worker threads
+ @param version the version the chunks are decoded with, which must outlive the decoder
+ @param threads the number of worker threads, between 1 and MAX_DECODER_THREADS
+ @return the decoder, or NULL on error
+*/
+struct chunkDecoder* initChunkDecoder(const struct gameVersion* version, int threads);
+
+/*!
+ @brief Queues a CHUNK_DATA_AND_UPDATE_LIGHT packet for decoding
+ @param decoder the decoder, which must not be full
+ @param chunkX the x coordinate of the chunk
+ @param chunkZ the z coordinate of the chunk
+ @param minY the lowest block y coordinate of the dimension the chunk is in
+ @param height the height of that dimension
+ @param p the packet, whose payload gets copied
+ @return 0 on success, -1 for error
+*/
+int submitChunk(struct chunkDecoder* decoder, int32_t chunkX, int32_t chunkZ, int32_t minY, int32_t height, const packet* p);
+
+/*!
+ @brief Checks if another chunk packet can be submitted
+ @param decoder the decoder
+ @return true if CHUNK_DECODER_DEPTH packets are waiting to be taken
+*/
+bool chunkDecoderFull(const struct chunkDecoder* decoder);
+
+/*!
+ @brief Takes the chunk decoded from the oldest submitted packet
+ @param decoder the decoder
+ @param wait if true blocks until the oldest packet is decoded, else returns 1 if it isn't yet
+ @param out pointer to where the chunk should be stored. It's detached from any gamestate and owned by the caller
+ @return 0 if a chunk was taken, 1 if there is nothing to take, -1 or -2 if the packet failed to decode and was dropped
+*/
+int takeDecodedChunk(struct chunkDecoder* decoder, bool wait, struct chunk** out);
+
+/*!
+ @brief Finds how many chunks have to be taken until every submitted packet for the given chunk is taken
+ @param decoder the decoder
+ @param chunkX the x coordinate of the chunk
+ @param chunkZ the z coordinate of the chunk
+ @return the number of chunks, or 0 if there are no pending packets for this chunk
+*/
+size_t pendingChunkDepth(const struct chunkDecoder* decoder, int32_t chunkX, int32_t chunkZ);
+
+/*!
+ @brief Gets the decoder counters
+ @param decoder the decoder
+ @return the counters
+*/
+struct chunkDecoderStats getChunkDecoderStats(const struct chunkDecoder* decoder);
+
+/*!
+ @brief Stops the worker threads and frees the decoder, along with every chunk that wasn't taken
+ @param decoder the decoder
+ @return 0 on success, -1 if a thread couldn't be joined
+*/
+int freeChunkDecoder(struct chunkDecoder* decoder);
+
+#endif
@@ -21,16 +21,23 @@
 #include "networkingMc.h"
 #include "packetDefinitions.h"
 #include "gamestateMc.h"
+#include "versionCacheMc.h"
+#include "recordingMc.h"
 
 #define VERSION_JSON "./19.4.json"
 
 #define BIOMES_JSON "./biomes.json"
 
+#define VERSION_CACHE "./19.4.cache" //made from the json files on the first run
+
+#define CHUNK_DECODER_THREADS 4
+
 //https://wiki.vg/Protocol#Definitions
 
 int main(int argc, char** argv){
     if(argc < 4){
-        fprintf(stderr, "Invalid number of arguments.");
+        fprintf(stderr, "Invalid number of arguments.\n");
+        fprintf(stderr, "Usage: %s <host> <port> <protocol> [recording]\n", argv[0]);
         return EXIT_FAILURE;
     }
     char* host = argv[1];
@@ -47,20 +54,22 @@ int main(int argc, char** argv){
         return EXIT_FAILURE;
     }
     printf("Connected to the server\n");
+    struct connection* conn = initConnection(sockFd);
     //fflush(stdout);
     //now we are ready to communicate
     //let's start by doing the handshake
-    handshake(sockFd, host, protocol, port, STATUS_STATE);
+    handshake(conn, host, protocol, port, STATUS_STATE);
     //request the status
-    char* status = getServerStatus(sockFd);
+    char* status = getServerStatus(conn);
     if(status == NULL){
         fprintf(stderr, "Invalid packet received instead of the server status\n");
         return EXIT_FAILURE;
     }
     free(status);
     //do the ping pong
-    int64_t delay = pingPong(sockFd);
+    int64_t delay = pingPong(conn);
     printf("%ld time difference detected.\n", delay);
+    freeConnection(conn);
     close(sockFd); //we have to reset the socket
     //Login state
     sockFd = socket(AF_INET, SOCK_STREAM, 0);
@@ -69,14 +78,15 @@ int main(int argc, char** argv){
         return EXIT_FAILURE;
     }
     connectSocket(sockFd, host, port);
-    handshake(sockFd, host, protocol, port, LOGIN_STATE);
+    conn = initConnection(sockFd);
+    handshake(conn, host, protocol, port, LOGIN_STATE);
     const char* username = "Botty";
     UUID_t player = 0;
-    startLogin(sockFd, username, NULL);
-    packet response = getPacket(sockFd, NO_COMPRESSION);
+    startLogin(conn, username, NULL);
+    packet response = getPacket(conn, NO_COMPRESSION);
     int compression = NO_COMPRESSION;
     //Login state
-    int result = loginState(sockFd, &response, &player, username, &compression);
+    int result = loginState(conn, &response, &player, username, &compression);
     if(result != 0){
         if(result < 0){
             perror("Error encountered during login");
@@ -84,10 +94,31 @@ int main(int argc, char** argv){
         return result;
     }
     printf("Successfully logged in\n");
+    //response still holds LOGIN_SUCCESS, the play state starts with the packet after it
+    releasePacket(conn, &response);
+    //record the play state, so that it can be replayed without the server
+    if(argc > 4 && startRecording(conn, argv[4]) != 0){
+        perror("Couldn't start the recording");
+    }
+    //frame and decompress packets on a separate thread, so that slow parsing doesn't delay reading or keep alive replies
+    if(startPipeline(conn, compression, NULL, true) != 0){
+        perror("Couldn't start the pipeline");
+    }
     struct gamestate current = initGamestate();
-    struct gameVersion* thisVersion = createVersionStruct(VERSION_JSON, BIOMES_JSON, protocol);
-    result = playState(&current, response, sockFd, compression, thisVersion);
+    struct gameVersion* thisVersion = createCachedVersionStruct(VERSION_JSON, BIOMES_JSON, VERSION_CACHE, protocol);
+    //joining sends hundreds of chunks at once, so they are decoded in parallel
+    if(startChunkDecoding(&current, thisVersion, CHUNK_DECODER_THREADS) != 0){
+        perror("Couldn't start the chunk decoding");
+    }
+    response = getPacket(conn, compression);
+    if(response.data == NULL){
+        perror("Error while getting a packet");
+        return EXIT_FAILURE;
+    }
+    result = playState(&current, response, conn, compression, thisVersion);
+    stopChunkDecoding(&current);
     freeVersionStruct(thisVersion);
+    freeConnection(conn);
     freeGamestate(&current);
     if(result < 0){
         perror("Error encountered during play state handling");
@@ -0,0 +1,768 @@
+#include "entityStoreMc.h"
+#include "gamestateMc.h"
+
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+/*Entity store note
+Both maps use linear probing and are kept at most half full. Removal shifts the following entries of the probe run back instead of leaving tombstones, so lookups never slow down as entities come and go.
+Every entity remembers where it sits in the all array and in the array of it's type, which lets removal swap the last entity into the hole in constant time.
+The kinematics rows follow the all array, so a removal moves the last row into the hole as well.
+The spatial hash only has to be touched when an entity crosses into another cell. Coordinates beyond what a cell key holds are clamped into the outermost cells, which keeps keys unique, and since queries clamp the same way they still find those entities. Queries look up every cell overlapping the bounding box of the query, unless there are fewer occupied cells than that, in which case the occupied cells are scanned instead
+*/
+
+#define CELL_HORIZONTAL_BITS 24 //bits of the x and z cell coordinates packed into a key, which reach well past the world border at 30 million blocks
+#define CELL_VERTICAL_BITS 16 //bits of the y cell coordinate, since dimensions are far lower than they are wide
+
+//An entity found by a query, alongside it's squared distance
+struct candidate{
+    struct entity* e;
+    double distance;
+};
+
+//A growable array of candidates
+struct candidates{
+    struct candidate* entries;
+    size_t count;
+    size_t capacity;
+};
+
+//A vector of KINEMATICS_LANES doubles, which gcc maps to whatever SIMD registers the target has
+typedef double kinematicsVector __attribute__((vector_size(KINEMATICS_LANES * sizeof(double))));
+
+//Private functions
+
+/*!
+ @brief Hashes an entity id. Ids are handed out sequentially, so they get mixed before being masked
+ @param eid the entity id
+ @return the hash
+*/
+static inline size_t hashId(int32_t eid);
+
+/*!
+ @brief Hashes a UUID
+ @param uuid the UUID
+ @return the hash
+*/
+static inline size_t hashUUID(UUID_t uuid);
+
+/*!
+ @brief Doubles the number of slots in the entity id map, or allocates the first ENTITY_MAP_MIN of them
+ @param store the store
+ @return 0 on success, -1 for error
+*/
+static int growIds(struct entityStore* store);
+
+/*!
+ @brief Doubles the number of slots in the UUID map, or allocates the first ENTITY_MAP_MIN of them
+ @param store the store
+ @return 0 on success, -1 for error
+*/
+static int growUUIDs(struct entityStore* store);
+
+/*!
+ @brief Appends the entity to the array
+ @param array the array
+ @param e the entity
+ @return the index of the entity, or -1 for error
+*/
+static int64_t appendEntity(struct entityArray* array, struct entity* e);
+
+/*!
+ @brief Removes the entity at the given index by moving the last entity into it's place
+ @param array the array
+ @param index the index of the entity to remove
+ @return the entity that was moved, or NULL if the removed one was last
+*/
+static struct entity* swapRemoveEntity(struct entityArray* array, size_t index);
+
+/*!
+ @brief Reallocates every kinematics array to the given number of rows
+ @param k the kinematics
+ @param capacity the new number of rows
+ @return 0 on success, -1 for error
+*/
+static int growKinematics(struct kinematics* k, size_t capacity);
+
+/*!
+ @brief Copies a kinematics row over another one
+ @param k the kinematics
+ @param from the row to copy
+ @param to the row to overwrite
+*/
+static void copyKinematics(struct kinematics* k, size_t from, size_t to);
+
+/*!
+ @brief Advances the extrapolation of a range of rows, one vector at a time
+ @param k the kinematics
+ @param count the number of rows, must be a multiple of KINEMATICS_LANES
+ @param ticks the number of ticks that passed
+*/
+static void extrapolateVectors(struct kinematics* k, size_t count, double ticks);
+
+/*!
+ @brief Gets the key of the spatial hash cell containing the given position
+ @param x the x coordinate
+ @param y the y coordinate
+ @param z the z coordinate
+ @return the cell key
+*/
+static uint64_t cellKey(double x, double y, double z);
+
+/*!
+ @brief Gets the coordinate of the cell containing the given coordinate, clamped to what fits into a cell key
+ @param v the coordinate, which must be finite
+ @param bits the number of bits the cell coordinate is packed into
+ @return the cell coordinate
+*/
+static inline int64_t cellCoordinate(double v, int bits);
+
+/*!
+ @brief Packs cell coordinates into a cell key
+*/
+static inline uint64_t packCell(int64_t cx, int64_t cy, int64_t cz);
+
+/*!
+ @brief Hashes a cell key
+*/
+static inline size_t hashCell(uint64_t key);
+
+/*!
+ @brief Finds the cell with the given key
+ @param grid the spatial hash
+ @param key the cell key
+ @return the cell, or NULL if it's empty
+*/
+static struct spatialCell* findCell(const struct spatialHash* grid, uint64_t key);
+
+/*!
+ @brief Adds the entity to the cell with the given key, creating the cell if necessary
+ @param grid the spatial hash
+ @param e the entity
+ @param key the cell key
+ @return 0 on success, -1 for error
+*/
+static int insertIntoCell(struct spatialHash* grid, struct entity* e, uint64_t key);
+
+/*!
+ @brief Removes an entity from a cell, dropping the cell once it's empty
+ @param grid the spatial hash
+ @param key the key of the cell
+ @param index where the entity sits in the cell
+*/
+static void removeFromCell(struct spatialHash* grid, uint64_t key, uint32_t index);
+
+/*!
+ @brief Doubles the number of slots in the spatial hash, or allocates the first ENTITY_MAP_MIN of them
+ @param grid the spatial hash
+ @return 0 on success, -1 for error
+*/
+static int growCells(struct spatialHash* grid);
+
+/*!
+ @brief Collects every entity of the given type whose server position is within the radius
+ @param store the store
+ @param x the x coordinate of the center
+ @param y the y coordinate of the center
+ @param z the z coordinate of the center
+ @param radius the radius in blocks
+ @param type the entity type to look for, or ANY_ENTITY_TYPE
+ @param found the array the entities get appended to
+ @return 0 on success, -1 for error
+*/
+static int collectInRadius(const struct entityStore* store, double x, double y, double z, double radius, int type, struct candidates* found);
+
+/*!
+ @brief Appends the entity to the candidates if it matches the query
+ @return 0 on success, -1 for error
+*/
+static int considerCandidate(const struct entityStore* store, struct entity* e, double x, double y, double z, double radius, int type, struct candidates* found);
+
+int addEntity(struct entityStore* store, struct entity* e){
+    if((store->all.count + 1) * 2 > store->idCapacity && growIds(store) != 0){
+        return -1;
+    }
+    if(e->uid != 0 && (store->uuidCount + 1) * 2 > store->uuidCapacity && growUUIDs(store) != 0){
+        return -1;
+    }
+    if(store->byType == NULL){
+        store->byType = calloc(ENTITY_TYPES, sizeof(struct entityArray));
+        if(store->byType == NULL){
+            return -1;
+        }
+    }
+    if(store->all.count == store->kinematics.capacity && growKinematics(&store->kinematics, store->kinematics.capacity == 0 ? 16 : store->kinematics.capacity * 2) != 0){
+        return -1;
+    }
+    int64_t storeIndex = appendEntity(&store->all, e);
+    if(storeIndex < 0){
+        return -1;
+    }
+    int64_t typeIndex = appendEntity(store->byType + e->type, e);
+    if(typeIndex < 0){
+        store->all.count--;
+        return -1;
+    }
+    if(insertIntoCell(&store->grid, e, cellKey(0, 0, 0)) != 0){
+        store->all.count--;
+        store->byType[e->type].count--;
+        return -1;
+    }
+    e->storeIndex = storeIndex;
+    e->typeIndex = typeIndex;
+    struct kinematics* k = &store->kinematics;
+    k->x[storeIndex] = k->y[storeIndex] = k->z[storeIndex] = 0;
+    k->velocityX[storeIndex] = k->velocityY[storeIndex] = k->velocityZ[storeIndex] = 0;
+    k->predictedX[storeIndex] = k->predictedY[storeIndex] = k->predictedZ[storeIndex] = 0;
+    k->age[storeIndex] = 0;
+    k->yaw[storeIndex] = k->pitch[storeIndex] = k->headYaw[storeIndex] = 0;
+    k->onGround[storeIndex] = false;
+    size_t mask = store->idCapacity - 1;
+    size_t i = hashId(e->id) & mask;
+    while(store->ids[i].e != NULL){
+        i = (i + 1) & mask;
+    }
+    store->ids[i].eid = e->id;
+    store->ids[i].e = e;
+    if(e->uid != 0){ //objects without a UUID, like experience orbs, can only be found by id
+        mask = store->uuidCapacity - 1;
+        i = hashUUID(e->uid) & mask;
+        while(store->uuids[i].e != NULL){
+            i = (i + 1) & mask;
+        }
+        store->uuids[i].uuid = e->uid;
+        store->uuids[i].e = e;
+        store->uuidCount++;
+    }
+    return 0;
+}
+
+struct entity* findEntity(const struct entityStore* store, int32_t eid){
+    if(store->ids == NULL){
+        return NULL;
+    }
+    size_t mask = store->idCapacity - 1;
+    for(size_t i = hashId(eid) & mask; store->ids[i].e != NULL; i = (i + 1) & mask){
+        if(store->ids[i].eid == eid){
+            return store->ids[i].e;
+        }
+    }
+    return NULL;
+}
+
+struct entity* findEntityByUUID(const struct entityStore* store, UUID_t uuid){
+    if(store->uuids == NULL){
+        return NULL;
+    }
+    size_t mask = store->uuidCapacity - 1;
+    for(size_t i = hashUUID(uuid) & mask; store->uuids[i].e != NULL; i = (i + 1) & mask){
+        if(store->uuids[i].uuid == uuid){
+            return store->uuids[i].e;
+        }
+    }
+    return NULL;
+}
+
+struct entity* removeEntity(struct entityStore* store, int32_t eid){
+    if(store->ids == NULL){
+        return NULL;
+    }
+    size_t mask = store->idCapacity - 1;
+    size_t i = hashId(eid) & mask;
+    while(store->ids[i].e != NULL && store->ids[i].eid != eid){
+        i = (i + 1) & mask;
+    }
+    struct entity* e = store->ids[i].e;
+    if(e == NULL){
+        return NULL;
+    }
+    //shift back every entry of the probe run that would become unreachable through the hole
+    for(size_t j = (i + 1) & mask; store->ids[j].e != NULL; j = (j + 1) & mask){
+        size_t home = hashId(store->ids[j].eid) & mask;
+        if(((j - home) & mask) >= ((j - i) & mask)){
+            store->ids[i] = store->ids[j];
+            i = j;
+        }
+    }
+    store->ids[i].e = NULL;
+    if(e->uid != 0){
+        mask = store->uuidCapacity - 1;
+        i = hashUUID(e->uid) & mask;
+        while(store->uuids[i].e != e){
+            i = (i + 1) & mask;
+        }
+        for(size_t j = (i + 1) & mask; store->uuids[j].e != NULL; j = (j + 1) & mask){
+            size_t home = hashUUID(store->uuids[j].uuid) & mask;
+            if(((j - home) & mask) >= ((j - i) & mask)){
+                store->uuids[i] = store->uuids[j];
+                i = j;
+            }
+        }
+        store->uuids[i].e = NULL;
+        store->uuidCount--;
+    }
+    removeFromCell(&store->grid, e->cell, e->cellIndex);
+    struct entity* moved = swapRemoveEntity(&store->all, e->storeIndex);
+    if(moved != NULL){
+        copyKinematics(&store->kinematics, moved->storeIndex, e->storeIndex);
+        moved->storeIndex = e->storeIndex;
+    }
+    moved = swapRemoveEntity(store->byType + e->type, e->typeIndex);
+    if(moved != NULL){
+        moved->typeIndex = e->typeIndex;
+    }
+    return e;
+}
+
+int setEntityPosition(struct entityStore* store, struct entity* e, double x, double y, double z){
+    if(!isfinite(x) || !isfinite(y) || !isfinite(z)){
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t key = cellKey(x, y, z);
+    if(key != e->cell){
+        uint64_t oldKey = e->cell;
+        uint32_t oldIndex = e->cellIndex;
+        if(insertIntoCell(&store->grid, e, key) != 0){ //leaves the entity where it was
+            return -1;
+        }
+        removeFromCell(&store->grid, oldKey, oldIndex);
+    }
+    struct kinematics* k = &store->kinematics;
+    k->x[e->storeIndex] = k->predictedX[e->storeIndex] = x;
+    k->y[e->storeIndex] = k->predictedY[e->storeIndex] = y;
+    k->z[e->storeIndex] = k->predictedZ[e->storeIndex] = z;
+    k->age[e->storeIndex] = 0;
+    return 0;
+}
+
+int moveEntity(struct entityStore* store, struct entity* e, double dx, double dy, double dz){
+    struct kinematics* k = &store->kinematics;
+    return setEntityPosition(store, e, k->x[e->storeIndex] + dx, k->y[e->storeIndex] + dy, k->z[e->storeIndex] + dz);
+}
+
+int64_t entitiesInRadius(const struct entityStore* store, double x, double y, double z, double radius, int type, struct entity** out, size_t max){
+    if(!isfinite(x) || !isfinite(y) || !isfinite(z) || !isfinite(radius)){
+        errno = EINVAL;
+        return -1;
+    }
+    struct candidates found = {};
+    if(collectInRadius(store, x, y, z, radius, type, &found) != 0){
+        free(found.entries);
+        return -1;
+    }
+    for(size_t i = 0; i < found.count && i < max; i++){
+        out[i] = found.entries[i].e;
+    }
+    free(found.entries);
+    return found.count;
+}
+
+int nearestEntities(const struct entityStore* store, double x, double y, double z, double maxRadius, int type, struct entity** out, size_t k){
+    if(!isfinite(x) || !isfinite(y) || !isfinite(z) || !isfinite(maxRadius)){
+        errno = EINVAL;
+        return -1;
+    }
+    if(k == 0){
+        return 0;
+    }
+    struct candidates found = {};
+    double radius = SPATIAL_CELL_SIZE;
+    while(true){
+        if(radius > maxRadius){
+            radius = maxRadius;
+        }
+        found.count = 0;
+        if(collectInRadius(store, x, y, z, radius, type, &found) != 0){
+            free(found.entries);
+            return -1;
+        }
+        //once k entities are within the radius, nothing outside of it can be closer than them
+        if(found.count >= k || radius >= maxRadius){
+            break;
+        }
+        radius *= 2;
+    }
+    size_t n = found.count < k ? found.count : k;
+    for(size_t i = 0; i < n; i++){ //k is small, so a partial selection sort does
+        size_t best = i;
+        for(size_t j = i + 1; j < found.count; j++){
+            if(found.entries[j].distance < found.entries[best].distance){
+                best = j;
+            }
+        }
+        struct candidate tmp = found.entries[i];
+        found.entries[i] = found.entries[best];
+        found.entries[best] = tmp;
+        out[i] = found.entries[i].e;
+    }
+    free(found.entries);
+    return n;
+}
+
+void extrapolateEntities(struct entityStore* store, double ticks){
+    struct kinematics* k = &store->kinematics;
+    size_t vectorized = store->all.count - (store->all.count % KINEMATICS_LANES);
+    extrapolateVectors(k, vectorized, ticks);
+    for(size_t i = vectorized; i < store->all.count; i++){
+        k->age[i] += ticks;
+        k->predictedX[i] = k->x[i] + k->velocityX[i] * k->age[i];
+        k->predictedY[i] = k->y[i] + k->velocityY[i] * k->age[i];
+        k->predictedZ[i] = k->z[i] + k->velocityZ[i] * k->age[i];
+    }
+}
+
+void freeEntityStore(struct entityStore* store, void (*freeEntity)(struct entity*)){
+    for(size_t i = 0; i < store->all.count; i++){
+        (*freeEntity)(store->all.entities[i]);
+    }
+    free(store->all.entities);
+    free(store->ids);
+    free(store->uuids);
+    if(store->byType != NULL){
+        for(int i = 0; i < ENTITY_TYPES; i++){
+            free(store->byType[i].entities);
+        }
+        free(store->byType);
+    }
+    struct kinematics* k = &store->kinematics;
+    free(k->x);
+    free(k->y);
+    free(k->z);
+    free(k->velocityX);
+    free(k->velocityY);
+    free(k->velocityZ);
+    free(k->predictedX);
+    free(k->predictedY);
+    free(k->predictedZ);
+    free(k->age);
+    free(k->yaw);
+    free(k->pitch);
+    free(k->headYaw);
+    free(k->onGround);
+    for(size_t i = 0; i < store->grid.capacity; i++){
+        free(store->grid.cells[i].entities.entities);
+    }
+    free(store->grid.cells);
+    memset(store, 0, sizeof(struct entityStore));
+}
+
+static inline size_t hashId(int32_t eid){
+    uint32_t h = (uint32_t)eid * 0x9E3779B1u;
+    return h ^ (h >> 16);
+}
+
+static inline size_t hashUUID(UUID_t uuid){
+    uint64_t h = (uint64_t)uuid ^ (uint64_t)(uuid >> 64);
+    h *= 0x9E3779B97F4A7C15ull;
+    return (size_t)(h ^ (h >> 32));
+}
+
+static int growIds(struct entityStore* store){
+    size_t capacity = store->idCapacity == 0 ? ENTITY_MAP_MIN : store->idCapacity * 2;
+    struct entitySlot* ids = calloc(capacity, sizeof(struct entitySlot));
+    if(ids == NULL){
+        return -1;
+    }
+    size_t mask = capacity - 1;
+    for(size_t n = 0; n < store->idCapacity; n++){
+        if(store->ids[n].e != NULL){
+            size_t i = hashId(store->ids[n].eid) & mask;
+            while(ids[i].e != NULL){
+                i = (i + 1) & mask;
+            }
+            ids[i] = store->ids[n];
+        }
+    }
+    free(store->ids);
+    store->ids = ids;
+    store->idCapacity = capacity;
+    return 0;
+}
+
+static int growUUIDs(struct entityStore* store){
+    size_t capacity = store->uuidCapacity == 0 ? ENTITY_MAP_MIN : store->uuidCapacity * 2;
+    struct uuidSlot* uuids = calloc(capacity, sizeof(struct uuidSlot));
+    if(uuids == NULL){
+        return -1;
+    }
+    size_t mask = capacity - 1;
+    for(size_t n = 0; n < store->uuidCapacity; n++){
+        if(store->uuids[n].e != NULL){
+            size_t i = hashUUID(store->uuids[n].uuid) & mask;
+            while(uuids[i].e != NULL){
+                i = (i + 1) & mask;
+            }
+            uuids[i] = store->uuids[n];
+        }
+    }
+    free(store->uuids);
+    store->uuids = uuids;
+    store->uuidCapacity = capacity;
+    return 0;
+}
+
+static int64_t appendEntity(struct entityArray* array, struct entity* e){
+    if(array->count == array->capacity){
+        size_t capacity = array->capacity == 0 ? 16 : array->capacity * 2;
+        struct entity** entities = realloc(array->entities, capacity * sizeof(struct entity*));
+        if(entities == NULL){
+            return -1;
+        }
+        array->entities = entities;
+        array->capacity = capacity;
+    }
+    array->entities[array->count] = e;
+    return array->count++;
+}
+
+static struct entity* swapRemoveEntity(struct entityArray* array, size_t index){
+    array->count--;
+    if(index == array->count){
+        return NULL;
+    }
+    array->entities[index] = array->entities[array->count];
+    return array->entities[index];
+}
+
+static int growKinematics(struct kinematics* k, size_t capacity){
+    //each array is swapped in as soon as it's reallocated, so a failure halfway leaves the old rows intact
+    double** doubles[] = {&k->x, &k->y, &k->z, &k->velocityX, &k->velocityY, &k->velocityZ, &k->predictedX, &k->predictedY, &k->predictedZ, &k->age};
+    for(size_t i = 0; i < sizeof(doubles) / sizeof(double*); i++){
+        double* grown = realloc(*doubles[i], capacity * sizeof(double));
+        if(grown == NULL){
+            return -1;
+        }
+        *doubles[i] = grown;
+    }
+    angle_t** angles[] = {&k->yaw, &k->pitch, &k->headYaw};
+    for(size_t i = 0; i < sizeof(angles) / sizeof(angle_t*); i++){
+        angle_t* grown = realloc(*angles[i], capacity * sizeof(angle_t));
+        if(grown == NULL){
+            return -1;
+        }
+        *angles[i] = grown;
+    }
+    bool* onGround = realloc(k->onGround, capacity * sizeof(bool));
+    if(onGround == NULL){
+        return -1;
+    }
+    k->onGround = onGround;
+    k->capacity = capacity;
+    return 0;
+}
+
+static void copyKinematics(struct kinematics* k, size_t from, size_t to){
+    k->x[to] = k->x[from];
+    k->y[to] = k->y[from];
+    k->z[to] = k->z[from];
+    k->velocityX[to] = k->velocityX[from];
+    k->velocityY[to] = k->velocityY[from];
+    k->velocityZ[to] = k->velocityZ[from];
+    k->predictedX[to] = k->predictedX[from];
+    k->predictedY[to] = k->predictedY[from];
+    k->predictedZ[to] = k->predictedZ[from];
+    k->age[to] = k->age[from];
+    k->yaw[to] = k->yaw[from];
+    k->pitch[to] = k->pitch[from];
+    k->headYaw[to] = k->headYaw[from];
+    k->onGround[to] = k->onGround[from];
+}
+
+static void extrapolateVectors(struct kinematics* k, size_t count, double ticks){
+    kinematicsVector step = {};
+    step += ticks;
+    //the arrays come from realloc, so the vectors are loaded and stored with memcpy which compiles to unaligned moves
+    for(size_t i = 0; i < count; i += KINEMATICS_LANES){
+        kinematicsVector age, position, velocity;
+        memcpy(&age, k->age + i, sizeof(kinematicsVector));
+        age += step;
+        memcpy(k->age + i, &age, sizeof(kinematicsVector));
+        memcpy(&position, k->x + i, sizeof(kinematicsVector));
+        memcpy(&velocity, k->velocityX + i, sizeof(kinematicsVector));
+        position += velocity * age;
+        memcpy(k->predictedX + i, &position, sizeof(kinematicsVector));
+        memcpy(&position, k->y + i, sizeof(kinematicsVector));
+        memcpy(&velocity, k->velocityY + i, sizeof(kinematicsVector));
+        position += velocity * age;
+        memcpy(k->predictedY + i, &position, sizeof(kinematicsVector));
+        memcpy(&position, k->z + i, sizeof(kinematicsVector));
+        memcpy(&velocity, k->velocityZ + i, sizeof(kinematicsVector));
+        position += velocity * age;
+        memcpy(k->predictedZ + i, &position, sizeof(kinematicsVector));
+    }
+}
+
+static inline int64_t cellCoordinate(double v, int bits){
+    double limit = (double)(1ll << (bits - 1 + SPATIAL_CELL_BITS));
+    if(v < -limit){
+        v = -limit;
+    }
+    else if(v >= limit){
+        v = limit - 1;
+    }
+    return (int64_t)floor(v) >> SPATIAL_CELL_BITS;
+}
+
+static inline uint64_t packCell(int64_t cx, int64_t cy, int64_t cz){
+    uint64_t horizontalMask = (1ull << CELL_HORIZONTAL_BITS) - 1;
+    uint64_t verticalMask = (1ull << CELL_VERTICAL_BITS) - 1;
+    return (((uint64_t)cx & horizontalMask) << (CELL_HORIZONTAL_BITS + CELL_VERTICAL_BITS)) | (((uint64_t)cy & verticalMask) << CELL_HORIZONTAL_BITS) | ((uint64_t)cz & horizontalMask);
+}
+
+static uint64_t cellKey(double x, double y, double z){
+    return packCell(cellCoordinate(x, CELL_HORIZONTAL_BITS), cellCoordinate(y, CELL_VERTICAL_BITS), cellCoordinate(z, CELL_HORIZONTAL_BITS));
+}
+
+static inline size_t hashCell(uint64_t key){
+    key *= 0x9E3779B97F4A7C15ull;
+    return (size_t)(key ^ (key >> 32));
+}
+
+static struct spatialCell* findCell(const struct spatialHash* grid, uint64_t key){
+    if(grid->cells == NULL){
+        return NULL;
+    }
+    size_t mask = grid->capacity - 1;
+    for(size_t i = hashCell(key) & mask; grid->cells[i].entities.entities != NULL; i = (i + 1) & mask){
+        if(grid->cells[i].key == key){
+            return grid->cells + i;
+        }
+    }
+    return NULL;
+}
+
+static int insertIntoCell(struct spatialHash* grid, struct entity* e, uint64_t key){
+    struct spatialCell* cell = findCell(grid, key);
+    if(cell == NULL){
+        if((grid->count + 1) * 2 > grid->capacity && growCells(grid) != 0){
+            return -1;
+        }
+        size_t mask = grid->capacity - 1;
+        size_t i = hashCell(key) & mask;
+        while(grid->cells[i].entities.entities != NULL){
+            i = (i + 1) & mask;
+        }
+        cell = grid->cells + i;
+        cell->key = key;
+    }
+    int64_t index = appendEntity(&cell->entities, e);
+    if(index < 0){
+        return -1;
+    }
+    if(index == 0){ //the cell just got it's first entity, which makes it occupied
+        grid->count++;
+    }
+    e->cell = key;
+    e->cellIndex = index;
+    return 0;
+}
+
+static void removeFromCell(struct spatialHash* grid, uint64_t key, uint32_t index){
+    struct spatialCell* cell = findCell(grid, key);
+    struct entity* moved = swapRemoveEntity(&cell->entities, index);
+    if(moved != NULL){
+        moved->cellIndex = index;
+    }
+    if(cell->entities.count > 0){
+        return;
+    }
+    //the cell is empty, so it's dropped the same way removeEntity drops map entries
+    free(cell->entities.entities);
+    cell->entities = (struct entityArray){};
+    grid->count--;
+    size_t mask = grid->capacity - 1;
+    size_t i = cell - grid->cells;
+    for(size_t j = (i + 1) & mask; grid->cells[j].entities.entities != NULL; j = (j + 1) & mask){
+        size_t home = hashCell(grid->cells[j].key) & mask;
+        if(((j - home) & mask) >= ((j - i) & mask)){
+            grid->cells[i] = grid->cells[j];
+            grid->cells[j].entities = (struct entityArray){};
+            i = j;
+        }
+    }
+}
+
+static int growCells(struct spatialHash* grid){
+    size_t capacity = grid->capacity == 0 ? ENTITY_MAP_MIN : grid->capacity * 2;
+    struct spatialCell* cells = calloc(capacity, sizeof(struct spatialCell));
+    if(cells == NULL){
+        return -1;
+    }
+    size_t mask = capacity - 1;
+    for(size_t n = 0; n < grid->capacity; n++){
+        if(grid->cells[n].entities.entities != NULL){
+            size_t i = hashCell(grid->cells[n].key) & mask;
+            while(cells[i].entities.entities != NULL){
+                i = (i + 1) & mask;
+            }
+            cells[i] = grid->cells[n];
+        }
+    }
+    free(grid->cells);
+    grid->cells = cells;
+    grid->capacity = capacity;
+    return 0;
+}
+
+static int collectInRadius(const struct entityStore* store, double x, double y, double z, double radius, int type, struct candidates* found){
+    const struct spatialHash* grid = &store->grid;
+    int64_t minX = cellCoordinate(x - radius, CELL_HORIZONTAL_BITS), maxX = cellCoordinate(x + radius, CELL_HORIZONTAL_BITS);
+    int64_t minY = cellCoordinate(y - radius, CELL_VERTICAL_BITS), maxY = cellCoordinate(y + radius, CELL_VERTICAL_BITS);
+    int64_t minZ = cellCoordinate(z - radius, CELL_HORIZONTAL_BITS), maxZ = cellCoordinate(z + radius, CELL_HORIZONTAL_BITS);
+    double boxCells = (double)(maxX - minX + 1) * (double)(maxY - minY + 1) * (double)(maxZ - minZ + 1);
+    if(boxCells > grid->count){ //cheaper to look at every occupied cell
+        for(size_t i = 0; i < grid->capacity; i++){
+            const struct entityArray* cell = &grid->cells[i].entities;
+            for(size_t n = 0; n < cell->count; n++){
+                if(considerCandidate(store, cell->entities[n], x, y, z, radius, type, found) != 0){
+                    return -1;
+                }
+            }
+        }
+        return 0;
+    }
+    for(int64_t cx = minX; cx <= maxX; cx++){
+        for(int64_t cy = minY; cy <= maxY; cy++){
+            for(int64_t cz = minZ; cz <= maxZ; cz++){
+                struct spatialCell* cell = findCell(grid, packCell(cx, cy, cz));
+                if(cell == NULL){
+                    continue;
+                }
+                for(size_t n = 0; n < cell->entities.count; n++){
+                    if(considerCandidate(store, cell->entities.entities[n], x, y, z, radius, type, found) != 0){
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int considerCandidate(const struct entityStore* store, struct entity* e, double x, double y, double z, double radius, int type, struct candidates* found){
+    if(type != ANY_ENTITY_TYPE && e->type != type){
+        return 0;
+    }
+    double dx = kinematicsOf(store, e, x) - x;
+    double dy = kinematicsOf(store, e, y) - y;
+    double dz = kinematicsOf(store, e, z) - z;
+    double distance = dx * dx + dy * dy + dz * dz;
+    if(distance > radius * radius){
+        return 0;
+    }
+    if(found->count == found->capacity){
+        size_t capacity = found->capacity == 0 ? 16 : found->capacity * 2;
+        struct candidate* entries = realloc(found->entries, capacity * sizeof(struct candidate));
+        if(entries == NULL){
+            return -1;
+        }
+        found->entries = entries;
+        found->capacity = capacity;
+    }
+    found->entries[found->count].e = e;
+    found->entries[found->count].distance = distance;
+    found->count++;
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "mcTypes.h"
+
+//Storage for the entities tracked by a gamestate, with constant time lookups by entity id and UUID and per type iteration
+
+#ifndef ENTITY_STORE_MC
+#define ENTITY_STORE_MC
+
+#define ENTITY_TYPES 256 //entity type ids are stored in a uint8_t
+#define ENTITY_MAP_MIN 64 //initial number of slots in each of the hash maps
+#define KINEMATICS_LANES 4 //number of entities extrapolateEntities advances per vector operation
+#define SPATIAL_CELL_BITS 4 //log2 of the edge length of a spatial hash cell, so cells are as big as chunk sections
+#define SPATIAL_CELL_SIZE (1 << SPATIAL_CELL_BITS)
+#define ANY_ENTITY_TYPE -1 //type filter of the spatial queries that matches every entity
+
+struct entity;
+
+/*!
+ @struct entitySlot
+ @brief A slot of the entity id map. Empty if e is NULL
+*/
+struct entitySlot{
+    int32_t eid;
+    struct entity* e;
+};
+
+/*!
+ @struct uuidSlot
+ @brief A slot of the UUID map. Empty if e is NULL
+*/
+struct uuidSlot{
+    UUID_t uuid;
+    struct entity* e;
+};
+
+/*!
+ @struct entityArray
+ @brief A growable array of entity pointers
+*/
+struct entityArray{
+    struct entity** entities;
+    size_t count;
+    size_t capacity;
+};
+
+/*!
+ @struct kinematics
+ @brief The movement state of every entity in an entityStore as a structure of arrays, so that sweeps over positions only touch positions. Row i belongs to all.entities[i]
+ @param x the x coordinate last sent by the server
+ @param y the y coordinate last sent by the server
+ @param z the z coordinate last sent by the server
+ @param velocityX the x velocity in blocks per tick
+ @param velocityY the y velocity in blocks per tick
+ @param velocityZ the z velocity in blocks per tick
+ @param predictedX the x coordinate extrapolated by extrapolateEntities
+ @param predictedY the y coordinate extrapolated by extrapolateEntities
+ @param predictedZ the z coordinate extrapolated by extrapolateEntities
+ @param age the number of ticks since the server last sent the position
+ @param yaw the body yaw
+ @param pitch the pitch
+ @param headYaw the head yaw
+ @param onGround whether the entity is on the ground
+ @param capacity the number of rows allocated
+*/
+struct kinematics{
+    double* x;
+    double* y;
+    double* z;
+    double* velocityX;
+    double* velocityY;
+    double* velocityZ;
+    double* predictedX;
+    double* predictedY;
+    double* predictedZ;
+    double* age;
+    angle_t* yaw;
+    angle_t* pitch;
+    angle_t* headYaw;
+    bool* onGround;
+    size_t capacity;
+};
+
+/*!
+ @struct spatialCell
+ @brief A cell of the spatial hash and the entities whose server position lies within it. Empty if entities.entities is NULL
+*/
+struct spatialCell{
+    uint64_t key;
+    struct entityArray entities;
+};
+
+/*!
+ @struct spatialHash
+ @brief Uniform grid over the world, stored as a linear probing map from cell coordinates to the entities in that cell. Only occupied cells are kept
+ @param cells the map, with capacity slots (a power of 2)
+ @param capacity the number of slots in cells
+ @param count the number of occupied cells
+*/
+struct spatialHash{
+    struct spatialCell* cells;
+    size_t capacity;
+    size_t count;
+};
+
+/*!
+ @struct entityStore
+ @brief Every tracked entity, densely packed, alongside open addressing maps that index them. A zeroed store is empty and valid
+ @param all every entity, in no particular order. Removing an entity moves the last one into it's place
+ @param ids linear probing map from entity id to entity, with idCapacity slots (a power of 2)
+ @param idCapacity the number of slots in ids
+ @param uuids linear probing map from UUID to entity, with uuidCapacity slots (a power of 2). Entities without a UUID aren't in it
+ @param uuidCapacity the number of slots in uuids
+ @param uuidCount the number of entities in uuids
+ @param byType ENTITY_TYPES arrays of the entities of each type, or NULL until the first entity is added
+ @param kinematics the movement state of the entities in all
+ @param grid spatial index over the server positions of the entities
+*/
+struct entityStore{
+    struct entityArray all;
+    struct entitySlot* ids;
+    size_t idCapacity;
+    struct uuidSlot* uuids;
+    size_t uuidCapacity;
+    size_t uuidCount;
+    struct entityArray* byType;
+    struct kinematics kinematics;
+    struct spatialHash grid;
+};
+
+/*!
+ @brief Accesses a kinematics field of an entity in the store, as an lvalue
+ @param store pointer to the entityStore
+ @param e pointer to an entity within the store
+ @param field the name of the kinematics array
+*/
+#define kinematicsOf(store, e, field) ((store)->kinematics.field[(e)->storeIndex])
+
+/*!
+ @brief Iterates over every entity in the store
+ @param store pointer to the entityStore
+ @param e the name of the provided entity* variable. Removing entities while iterating skips some of them
+*/
+#define foreachEntity(store, e) \
+    for(struct entity **e##It = (store)->all.entities, *e = NULL; e##It < (store)->all.entities + (store)->all.count && (e = *e##It) != NULL; e##It++)
+
+/*!
+ @brief Iterates over every entity of the given type in the store
+ @param store pointer to the entityStore
+ @param type the entity type id
+ @param e the name of the provided entity* variable. Removing entities while iterating skips some of them
+*/
+#define foreachEntityOfType(store, type, e) \
+    for(struct entity **e##It = (store)->byType != NULL ? (store)->byType[(uint8_t)(type)].entities : NULL, *e = NULL; (store)->byType != NULL && e##It < (store)->byType[(uint8_t)(type)].entities + (store)->byType[(uint8_t)(type)].count && (e = *e##It) != NULL; e##It++)
+
+/*!
+ @brief Adds the entity to the store, with all of it's kinematics zeroed. It's id, uid and type must already be set
+ @param store the store
+ @param e the entity, which must not share an id with an entity already in the store
+ @return 0 on success, -1 for error
+*/
+int addEntity(struct entityStore* store, struct entity* e);
+
+/*!
+ @brief Finds the entity with the given id
+ @param store the store
+ @param eid the entity id
+ @return the entity, or NULL if it isn't tracked
+*/
+struct entity* findEntity(const struct entityStore* store, int32_t eid);
+
+/*!
+ @brief Finds the entity with the given UUID
+ @param store the store
+ @param uuid the UUID
+ @return the entity, or NULL if it isn't tracked
+*/
+struct entity* findEntityByUUID(const struct entityStore* store, UUID_t uuid);
+
+/*!
+ @brief Removes the entity with the given id from the store
+ @param store the store
+ @param eid the entity id
+ @return the removed entity, which the caller should free, or NULL if it wasn't tracked
+*/
+struct entity* removeEntity(struct entityStore* store, int32_t eid);
+
+/*!
+ @brief Sets the position the server sent for the entity, which restarts the extrapolation from it and moves it within the spatial hash
+ @param store the store
+ @param e the entity, which must be in the store
+ @param x the x coordinate
+ @param y the y coordinate
+ @param z the z coordinate
+ @return 0 on success, -1 for error, including coordinates that aren't finite
+*/
+int setEntityPosition(struct entityStore* store, struct entity* e, double x, double y, double z);
+
+/*!
+ @brief Moves the entity by a delta the server sent, which restarts the extrapolation from the new position
+ @param store the store
+ @param e the entity, which must be in the store
+ @param dx the change of the x coordinate
+ @param dy the change of the y coordinate
+ @param dz the change of the z coordinate
+ @return 0 on success, -1 for error
+*/
+int moveEntity(struct entityStore* store, struct entity* e, double dx, double dy, double dz);
+
+/*!
+ @brief Dead reckoning for every entity at once. Ages every entity by the given number of ticks and sets it's predicted position to the server position plus velocity times age
+ @param store the store
+ @param ticks the number of ticks that passed since the previous call, may be fractional
+*/
+void extrapolateEntities(struct entityStore* store, double ticks);
+
+/*!
+ @brief Finds every entity whose server position is within the radius, in no particular order
+ @param store the store
+ @param x the x coordinate of the center
+ @param y the y coordinate of the center
+ @param z the z coordinate of the center
+ @param radius the radius in blocks
+ @param type the entity type to look for, or ANY_ENTITY_TYPE
+ @param out array the entities get written to
+ @param max the maximum number of entities written to out
+ @return the number of entities within the radius, which may be more than were written, or -1 for error, including a center or radius that isn't finite
+*/
+int64_t entitiesInRadius(const struct entityStore* store, double x, double y, double z, double radius, int type, struct entity** out, size_t max);
+
+/*!
+ @brief Finds the k entities closest to the given point, searching outwards cell by cell
+ @param store the store
+ @param x the x coordinate of the point
+ @param y the y coordinate of the point
+ @param z the z coordinate of the point
+ @param maxRadius entities further than this are never returned
+ @param type the entity type to look for, or ANY_ENTITY_TYPE
+ @param out array of at least k entries the entities get written to, closest first
+ @param k the number of entities to find
+ @return the number of entities written, or -1 for error, including a point or radius that isn't finite
+*/
+int nearestEntities(const struct entityStore* store, double x, double y, double z, double maxRadius, int type, struct entity** out, size_t k);
+
+/*!
+ @brief Frees the store and every entity within it
+ @param store the store, which is left empty
+ @param freeEntity function that frees a single entity
+*/
+void freeEntityStore(struct entityStore* store, void (*freeEntity)(struct entity*));
+
+#endif
@@ -0,0 +1,268 @@
+#include "eventLoopMc.h"
+#include "packetDefinitions.h"
+
+#include <stdbool.h>
+#include <errno.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+/*Event loop note
+Every socket is non-blocking and registered with a single epoll instance. A bot only ever advances when epoll says it's socket is ready:
+BOT_CONNECTING -writable-> handshake and login start are sent -> BOT_LOGIN -LOGIN_SUCCESS-> BOT_PLAY
+On readability getPacket is called until the receive buffer runs dry and the socket reports EAGAIN, so a partial packet simply waits in the buffer.
+Replies that a full socket doesn't take stay queued in the connection, and the bot is registered for writability until they are drained. Draining never releases packets collected while the connection is corked
+*/
+
+//Private functions
+
+/*!
+ @brief Checks the outcome of the non-blocking connect and sends the handshake and login start
+ @param loop the loop driving the bot
+ @param b the bot whose socket became writable
+*/
+static void finishConnect(struct eventLoop* loop, struct bot* b);
+
+/*!
+ @brief Handles every packet that can be framed from what the socket has, without blocking
+ @param loop the loop driving the bot
+ @param b the bot whose socket became readable
+*/
+static void readBot(struct eventLoop* loop, struct bot* b);
+
+/*!
+ @brief Advances the bot's gamestate by the time that passed since it was last advanced
+ @param b the bot, which must be in the play state
+ @param now the current time
+*/
+static void advanceBot(struct bot* b, const struct timespec* now);
+
+/*!
+ @brief Registers the bot for writability only while it has queued bytes
+ @param loop the loop driving the bot
+ @param b the bot to update
+ @return 0 on success, -1 for error
+*/
+static int updateInterest(struct eventLoop* loop, struct bot* b);
+
+/*!
+ @brief Closes the bot's socket and marks it as closed
+ @param loop the loop driving the bot
+ @param b the bot to close
+ @param result why the bot was closed
+*/
+static void closeBot(struct eventLoop* loop, struct bot* b, int result);
+
+/*!
+ @brief Frees the bot, closing it's socket if it's still open
+ @param b the bot to free
+*/
+static void freeBot(struct bot* b);
+
+struct eventLoop* initEventLoop(const struct gameVersion* version){
+    struct eventLoop* loop = calloc(1, sizeof(struct eventLoop));
+    if(loop == NULL){
+        return NULL;
+    }
+    loop->epollFd = epoll_create1(0);
+    if(loop->epollFd < 0){
+        free(loop);
+        return NULL;
+    }
+    loop->bots = initList();
+    loop->version = version;
+    return loop;
+}
+
+struct bot* addBot(struct eventLoop* loop, const char* host, uint16_t port, int32_t protocol, const char* username){
+    struct bot* b = calloc(1, sizeof(struct bot));
+    if(b == NULL){
+        return NULL;
+    }
+    int socketFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(socketFd < 0){
+        free(b);
+        return NULL;
+    }
+    if(connectSocket(socketFd, host, port) != 0 && errno != EINPROGRESS){
+        close(socketFd);
+        free(b);
+        return NULL;
+    }
+    b->conn = initConnection(socketFd);
+    if(b->conn == NULL){
+        close(socketFd);
+        free(b);
+        return NULL;
+    }
+    b->state = BOT_CONNECTING;
+    b->compression = NO_COMPRESSION;
+    b->host = strdup(host);
+    b->port = port;
+    b->protocol = protocol;
+    b->username = strdup(username);
+    b->gamestate = initGamestate();
+    //the connect is done once the socket becomes writable
+    b->events = EPOLLOUT;
+    struct epoll_event ev = {};
+    ev.events = b->events;
+    ev.data.ptr = b;
+    if(b->host == NULL || b->username == NULL || epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, socketFd, &ev) != 0){
+        freeBot(b);
+        return NULL;
+    }
+    addElement(loop->bots, b);
+    loop->open++;
+    return b;
+}
+
+int runEventLoop(struct eventLoop* loop, int timeout){
+    struct epoll_event events[EVENT_BATCH];
+    int ready = epoll_wait(loop->epollFd, events, EVENT_BATCH, timeout);
+    if(ready < 0){
+        if(errno == EINTR){
+            return loop->open;
+        }
+        return -1;
+    }
+    for(int i = 0; i < ready; i++){
+        struct bot* b = events[i].data.ptr;
+        uint32_t ev = events[i].events;
+        if(b->state == BOT_CONNECTING){
+            finishConnect(loop, b);
+        }
+        else{
+            if((ev & EPOLLOUT) && b->state != BOT_CLOSED && drainConnection(b->conn) < 0){
+                closeBot(loop, b, -1);
+            }
+            if((ev & (EPOLLIN | EPOLLHUP | EPOLLERR)) && b->state != BOT_CLOSED){
+                readBot(loop, b);
+            }
+        }
+        if(b->state != BOT_CLOSED && updateInterest(loop, b) != 0){
+            closeBot(loop, b, -1);
+        }
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    foreachListElement(loop->bots, el){
+        struct bot* b = el->value;
+        if(b->state == BOT_PLAY){
+            advanceBot(b, &now);
+        }
+    }
+    return loop->open;
+}
+
+void freeEventLoop(struct eventLoop* loop){
+    if(loop != NULL){
+        freeList(loop->bots, (freeLikeFunction)freeBot);
+        close(loop->epollFd);
+        free(loop);
+    }
+}
+
+static void finishConnect(struct eventLoop* loop, struct bot* b){
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if(getsockopt(b->conn->socketFd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0){
+        if(error != 0){
+            errno = error;
+        }
+        closeBot(loop, b, -1);
+        return;
+    }
+    if(handshake(b->conn, b->host, b->protocol, b->port, LOGIN_STATE) < 0 || startLogin(b->conn, b->username, NULL) < 0){
+        closeBot(loop, b, -1);
+        return;
+    }
+    b->state = BOT_LOGIN;
+}
+
+static void readBot(struct eventLoop* loop, struct bot* b){
+    while(b->state == BOT_LOGIN || b->state == BOT_PLAY){
+        errno = 0;
+        packet p = getPacket(b->conn, b->compression);
+        if(p.data == NULL){
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                closeBot(loop, b, -4);
+            }
+            return;
+        }
+        if(b->state == BOT_LOGIN){
+            int result = handleLoginPacket(b->conn, &p, &b->uuid, b->username, &b->compression);
+            releasePacket(b->conn, &p);
+            if(result == 0){
+                b->state = BOT_PLAY;
+                clock_gettime(CLOCK_MONOTONIC, &b->advanced);
+            }
+            else if(result != LOGIN_PENDING){
+                closeBot(loop, b, result);
+            }
+        }
+        else{
+            int result = handlePlayPacket(&b->gamestate, &p, b->conn, b->compression, loop->version);
+            if(result != 1){
+                closeBot(loop, b, result);
+            }
+        }
+    }
+}
+
+static void advanceBot(struct bot* b, const struct timespec* now){
+    int64_t elapsed = (int64_t)(now->tv_sec - b->advanced.tv_sec) * 1000000 + (now->tv_nsec - b->advanced.tv_nsec) / 1000;
+    if(elapsed <= 0){
+        return;
+    }
+    advanceGamestate(&b->gamestate, elapsed);
+    //only whole microseconds are handed over, the rest is left for the next call
+    b->advanced.tv_sec += elapsed / 1000000;
+    b->advanced.tv_nsec += (elapsed % 1000000) * 1000;
+    if(b->advanced.tv_nsec >= 1000000000){
+        b->advanced.tv_sec++;
+        b->advanced.tv_nsec -= 1000000000;
+    }
+}
+
+static int updateInterest(struct eventLoop* loop, struct bot* b){
+    uint32_t wanted = b->state == BOT_CONNECTING ? EPOLLOUT : EPOLLIN;
+    if(queuedBytes(b->conn) > 0){
+        wanted |= EPOLLOUT;
+    }
+    if(wanted == b->events){
+        return 0;
+    }
+    struct epoll_event ev = {};
+    ev.events = wanted;
+    ev.data.ptr = b;
+    if(epoll_ctl(loop->epollFd, EPOLL_CTL_MOD, b->conn->socketFd, &ev) != 0){
+        return -1;
+    }
+    b->events = wanted;
+    return 0;
+}
+
+static void closeBot(struct eventLoop* loop, struct bot* b, int result){
+    if(b->state == BOT_CLOSED){
+        return;
+    }
+    b->state = BOT_CLOSED;
+    b->result = result;
+    //closing the socket also removes it from the epoll instance
+    close(b->conn->socketFd);
+    b->conn->socketFd = -1;
+    loop->open--;
+}
+
+static void freeBot(struct bot* b){
+    if(b->state != BOT_CLOSED){
+        close(b->conn->socketFd);
+    }
+    freeConnection(b->conn);
+    freeGamestate(&b->gamestate);
+    free(b->host);
+    free(b->username);
+    free(b);
+}
@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "networkingMc.h"
+#include "gamestateMc.h"
+#include "list.h"
+
+//A single threaded engine driving many connections over non-blocking sockets and epoll, instead of a thread per connection
+//Linux only
+
+#ifndef EVENT_LOOP_MC
+#define EVENT_LOOP_MC
+
+#define EVENT_BATCH 64 //maximum number of readiness events handled per epoll_wait
+
+//The stage a bot is at
+enum botState{
+    BOT_CONNECTING, //the non-blocking connect hasn't finished yet
+    BOT_LOGIN, //handshake and login start are sent, waiting for LOGIN_SUCCESS
+    BOT_PLAY,
+    BOT_CLOSED
+};
+
+/*!
+ @struct bot
+ @brief A single connection driven by an event loop, alongside it's own gamestate
+ @param conn the connection over a non-blocking socket
+ @param state the stage the bot is at
+ @param result why the bot was closed. 0 for a server ordered disconnect, positive for a disconnect during login and negative for errors
+ @param compression the established compression level
+ @param host the address of the server
+ @param port the port of the server
+ @param protocol the protocol version used in the handshake
+ @param username the player username
+ @param uuid the UUID the server has given the player
+ @param gamestate the gamestate kept up to date with packets from this connection. Event handlers can be set right after addBot
+ @param events the epoll events the socket is currently registered for
+ @param advanced up to when the gamestate has been advanced, see advanceGamestate
+*/
+struct bot{
+    struct connection* conn;
+    enum botState state;
+    int result;
+    int compression;
+    char* host;
+    uint16_t port;
+    int32_t protocol;
+    char* username;
+    UUID_t uuid;
+    struct gamestate gamestate;
+    uint32_t events;
+    struct timespec advanced;
+};
+
+/*!
+ @struct eventLoop
+ @brief An epoll instance and all the bots it drives
+ @param epollFd the epoll file descriptor
+ @param bots list of all the bots added to the loop, including the closed ones
+ @param open the number of bots that aren't closed
+ @param version the version struct shared by all the bots
+*/
+struct eventLoop{
+    int epollFd;
+    listHead* bots;
+    size_t open;
+    const struct gameVersion* version;
+};
+
+/*!
+ @brief Initializes an event loop without any bots
+ @param version a previously created version struct, shared by all the bots. Must outlive the loop
+ @return the newly allocated loop, or NULL on error
+*/
+struct eventLoop* initEventLoop(const struct gameVersion* version);
+
+/*!
+ @brief Creates a bot and starts connecting it to the server. The handshake and login happen within runEventLoop
+ @param loop the loop that should drive the bot
+ @param host the address of the server
+ @param port the port of the server
+ @param protocol the protocol version utilized by the client
+ @param username the player username
+ @return the bot, owned by the loop, or NULL on error
+*/
+struct bot* addBot(struct eventLoop* loop, const char* host, uint16_t port, int32_t protocol, const char* username);
+
+/*!
+ @brief Waits for socket readiness once and advances every bot that is ready, never blocking on a single bot. Afterwards the gamestate of every bot in the play state is advanced by the time that passed
+ @param loop the loop to run
+ @param timeout the maximum time to wait in milliseconds, or -1 to wait until something happens. Client ticks only run as often as this returns, so keep it at most TICK_LENGTH / 1000 milliseconds
+ @return the number of bots that aren't closed, or -1 for error
+*/
+int runEventLoop(struct eventLoop* loop, int timeout);
+
+/*!
+ @brief Frees the loop and all of it's bots, closing their sockets
+ @param loop the loop to free
+*/
+void freeEventLoop(struct eventLoop* loop);
+
+#endif
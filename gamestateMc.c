@@ -4,6 +4,7 @@
 
 #include "gamestateMc.h"
 #include "packetDefinitions.h"
+#include "versionCacheMc.h"
 #include "stdbool.h"
 #include "cNBT/nbt.h"
 #include "cJSON/cJSON.h"
@@ -16,34 +17,171 @@
 static int getEntityId(const struct gameVersion* version, const char* name);
 
 /*!
- @brief Gets the double pointer to the block with the given position within the gamestate
+ @brief Finds the section holding the block at the given position
  @param current the currently worked on gamestate
  @param pos the block position
- @return NULL in case chunk is not there or the double pointer, which may point to NULL
+ @param c pointer to where the chunk holding the section should be stored, or NULL
+ @param x pointer to where the x coordinate within the section should be stored
+ @param y pointer to where the y coordinate within the section should be stored
+ @param z pointer to where the z coordinate within the section should be stored
+ @return NULL in case the chunk is not there, or the section
 */
-static block** getBlock(struct gamestate* current, position pos);
+static struct section* getSection(struct gamestate* current, position pos, chunk** c, int* x, int* y, int* z);
 
 /*!
- @brief Gets the entity with the given eid from the linked list
+ @brief Sets the block at the given position, dropping it's blockEntity and destroy stage if it becomes air
+ @param current the currently worked on gamestate
+ @param pos the block position
+ @param state the new global block state id
+ @param version pointer to a struct that defines all game version dependant constants
+ @return 0 on success or if the chunk isn't loaded, -1 for error
+*/
+static int setBlockState(struct gamestate* current, position pos, int32_t state, const struct gameVersion* version);
+
+/*!
+ @brief Puts together a snapshot of the block at the given position
+ @param current the currently worked on gamestate
+ @param pos the block position
+ @param version pointer to a struct that defines all game version dependant constants
+ @return the block, with a state of -1 if the chunk isn't loaded
+*/
+static block viewBlock(struct gamestate* current, position pos, const struct gameVersion* version);
+
+/*!
+ @brief Reads the block states of a single chunk section straight into it's packed storage
+ @param buff the buffer to read from
+ @param offset the pointer to the current index within buff
+ @param end the index the section may not go past
+ @param s the section to read into. Whatever it allocates is freed by freeChunk, even on error
+ @param version pointer to a struct that defines all game version dependant constants
+ @return 0 on success, -1 for error. errno is EPROTO or E2BIG if the section is malformed
+*/
+static int readSection(const byte* buff, int* offset, size_t end, struct section* s, const struct gameVersion* version);
+
+/*!
+ @brief Reads the sections and block entities of a CHUNK_DATA_AND_UPDATE_LIGHT payload into a chunk, never reading past the payload
+ @param data the packet payload
+ @param size the size of the payload
+ @param c the chunk to read into. Whatever it allocates is freed by freeChunk, even on error
+ @param version pointer to a struct that defines all game version dependant constants
+ @return 0 on success, -1 for error. errno is ENOMEM if an allocation failed, else the payload is malformed
+*/
+static int readChunkData(const byte* data, size_t size, chunk* c, const struct gameVersion* version);
+
+/*!
+ @brief Repacks the section's states with a different number of bits per entry
+ @param s the section
+ @param bits the new number of bits per entry
+ @param direct if true the palette is dropped and global state ids are stored instead
+ @return 0 on success, -1 for error
+*/
+static int repackSection(struct section* s, uint8_t bits, bool direct);
+
+/*!
+ @brief Finds the entry at the given location in one of the chunk side tables
+ @param table the blockEntities or destroyStages of a chunk
+ @param location the block position
+ @return the list element, or NULL
+*/
+static listEl* findByLocation(listHead* table, position location);
+
+/*!
+ @brief Allocates an empty chunk
+ @param x the chunk x coordinate
+ @param z the chunk z coordinate
+ @param minY the lowest block y coordinate of the dimension, a multiple of 16
+ @param height the height of the dimension, a positive multiple of 16
+ @return the chunk, or NULL on error
+*/
+static chunk* initChunk(int32_t x, int32_t z, int32_t minY, int32_t height);
+
+/*!
+ @brief Checks if the given global block state id is air, treating unknown states as air
+*/
+static bool stateIsAir(const struct gameVersion* version, int32_t state);
+
+/*!
+ @brief Gets the number of bits needed to store values below n
+*/
+static uint8_t bitsFor(size_t n);
+
+/*!
+ @brief Gets the entity with the given eid, which may be our own player
  @param current the gamestate from which we want to get the entity
  @param eid the id of the entity
  @return NULL or a reference to the entity
 */
 static entity* getEntity(struct gamestate* current, int32_t eid);
 
+/*!
+ @brief Adds a freshly spawned entity to the entity store
+ @param current the currently worked on gamestate
+ @param e the entity, which the gamestate takes ownership of even on error
+ @return 0 on success, -1 for error
+*/
+static int storeEntity(struct gamestate* current, entity* e);
+
 /*!
  @brief Parses raw bytes into an entity metadata object
  @param input the raw bytes
  @param offset the pointer to the current pointer withing input
- @return a new entity metadata object
+ @param size the size of input
+ @return a new entity metadata object, or NULL if it's NBT is malformed
+*/
+static struct entityMetadata* parseEntityMetadata(byte* input, int* offset, size_t size);
+
+/*!
+ @brief Removes the chunk from the chunk grid if it's loaded, and frees it's contents
+ @param current the currently worked on gamestate
+ @param chunkX the chunk x coordinate
+ @param chunkZ the chunk z coordinate
+*/
+static void unloadChunk(struct gamestate* current, int32_t chunkX, int32_t chunkZ);
+
+/*!
+ @brief Gets the slot of the chunk grid that the given chunk coordinates map to
+ @param grid the chunk grid, which must have slots
+ @param chunkX the chunk x coordinate
+ @param chunkZ the chunk z coordinate
+ @return pointer to the slot, which may hold a different chunk
 */
-static struct entityMetadata* parseEntityMetadata(byte* input, int* offset);
+static inline chunk** chunkSlot(const struct chunkGrid* grid, int32_t chunkX, int32_t chunkZ);
 
 /*!
- @brief Removes the chunk from the chunk list, and frees it's contents
- @param el the list element the chunk is attached to
+ @brief Checks if the given chunk coordinates are within the window of the chunk grid
 */
-static void unloadChunk(listEl* el);
+static inline bool inChunkGrid(const struct chunkGrid* grid, int32_t chunkX, int32_t chunkZ);
+
+/*!
+ @brief Frees the chunk held by the slot and empties the slot
+ @param current the currently worked on gamestate
+ @param slot the slot of the chunk grid
+*/
+static void evictChunk(struct gamestate* current, chunk** slot);
+
+/*!
+ @brief Stores the chunk in the chunk grid, replacing whatever was in it's slot. Chunks outside the window are freed
+ @param current the currently worked on gamestate
+ @param c the chunk, which the gamestate takes ownership of
+ @return 0 on success, -1 for error
+*/
+static int storeChunk(struct gamestate* current, chunk* c);
+
+/*!
+ @brief Resizes the chunk grid to fit the view distance, freeing the chunks that no longer fit
+ @param current the currently worked on gamestate
+ @param viewDistance the view distance the server uses
+ @return 0 on success, -1 for error
+*/
+static int resizeChunkGrid(struct gamestate* current, int32_t viewDistance);
+
+/*!
+ @brief Moves the window of the chunk grid, freeing the chunks that fall out of it
+ @param current the currently worked on gamestate
+ @param chunkX the x coordinate of the new center chunk
+ @param chunkZ the z coordinate of the new center chunk
+*/
+static void recenterChunkGrid(struct gamestate* current, int32_t chunkX, int32_t chunkZ);
 
 /*!
  @brief Little convenience function that combines malloc and memcpy that effectively does a shallow copy
@@ -54,14 +192,23 @@ static void unloadChunk(listEl* el);
 void* mCpyAlloc(const void* value, size_t size);
 
 /*!
- @brief Gets the chunk from the gamestate 
+ @brief Gets the chunk from the gamestate, first publishing the pending decodes of it if there are any
 */
-static chunk* getChunk(const struct gamestate* current, int32_t chunkX, int32_t chunkZ);
+static chunk* getChunk(struct gamestate* current, int32_t chunkX, int32_t chunkZ);
 
 /*!
- @brief Checks if the given type is air
+ @brief Stores the chunks the decoder has finished into the grid, in packet order. Chunks that fail to decode or to be stored are dropped
+ @param current the gamestate, which must have a chunkDecoder
+ @param count the number of chunks to store even if it means waiting for them to be decoded. Ones that are already decoded are stored after them either way
 */
-static bool isAir(const struct gameVersion* current, const identifier type);
+static void publishChunks(struct gamestate* current, size_t count);
+
+/*!
+ @brief Finds the properties of the current dimension type
+ @param current the gamestate
+ @return the dimension type from the registries, or the overworld if the server never sent it
+*/
+static const struct dimensionType* currentDimension(const struct gamestate* current);
 
 /*!
  @brief Allocates and initializes a new entity object
@@ -73,14 +220,35 @@ entity* initEntity();
 */
 static void freeEntity(entity* e);
 
-static inline void updateEntityPosition(entity* e, const byte* buff, int* index);
+/*!
+ @brief Puts the item into an equipment slot of the entity, or empties the slot if the item isn't present
+ @param e the entity
+ @param equipmentSlot the equipment slot
+ @param item the item, which the entity takes ownership of
+ @return 0 on success, -1 for error
+*/
+static int setEquipment(entity* e, byte equipmentSlot, slot item);
+
+/*!
+ @brief Reads a position delta and moves the entity by it
+ @return 0 on success, -1 for error
+*/
+static inline int updateEntityPosition(struct entityStore* store, entity* e, const byte* buff, int* index);
 
-static inline void updateEntityRotation(entity* e, const byte* buff, int* index);
+/*!
+ @brief Reads the yaw and pitch of the entity
+*/
+static inline void updateEntityRotation(struct entityStore* store, const entity* e, const byte* buff, int* index);
 
 /*!
- @brief Frees a block
+ @brief Reads the velocity of the entity, converting it to blocks per tick
 */
-static void freeBlock(block* b);
+static inline void readEntityVelocity(struct entityStore* store, const entity* e, const byte* buff, int* index);
+
+/*!
+ @brief Frees a blockEntity
+*/
+static void freeBlockEntity(blockEntity* e);
 
 /*!
  @brief Frees a generic player struct
@@ -91,8 +259,6 @@ static void freeEntityAttribute(struct entityAttribute* eA);
 
 static void freeContainer(struct container* c);
 
-static block* initBlock(int32_t x, int32_t y, int32_t z);
-
 static void freeBossBar(struct bossBar* bar);
 
 static struct title* initTitle();
@@ -126,6 +292,7 @@ static void freePlayerMessage(struct playerMessage* message);
 #define INFO_DISPLAY 0x20
 
 #define STATES_NUM 4096
+#define BIOMES_NUM 64
 
 #define biomePaletteThreshold 6
 #define blockPaletteThreshold 9
@@ -150,44 +317,50 @@ enum bossBarActions{
 Call me cynical but I would use a int8 for such a thing*/
 
 //Macro for getting the change value from a limited short
-#define deltaShortFormula(s) ((int16_t)s/(4096))
+#define deltaShortFormula(s) ((double)(int16_t)(s) / 4096.0)
 
 #define transplantBiomes(section, biomes, version) \
-    if(biomes.states == NULL){ \
-        for(int i = 0; i < 64; i++){ \
-            section->biome[i] = version->biomes.palette[*biomes.palette]; \
-        } \
-    } \
-    else{ \
-        for(int i = 0; i < 64; i++){ \
-            int32_t id = biomes.states[i]; \
-            if(biomes.palette != NULL){ \
-                id = biomes.palette[id]; \
-            } \
-            section->biome[i] = version->biomes.palette[id]; \
+    for(int i = 0; i < BIOMES_NUM; i++){ \
+        int32_t id = biomes.states[i]; \
+        if(biomes.paletteSize > 0){ \
+            id = biomes.palette[id]; \
         } \
+        section->biome[i] = version->biomes.palette[id]; \
     }
 
+//Declares a palettedContainer for the biomes of a single section, backed by storage on the stack
+#define biomeContainer(name) \
+    int32_t name##Palette[1 << (biomePaletteThreshold - 1)]; \
+    int32_t name##States[BIOMES_NUM]; \
+    palettedContainer name = {0, name##Palette, name##States};
+
 int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVersion* version){
     int offset = 0;
+    if(output->chunkDecoder != NULL){
+        publishChunks(output, 0);
+    }
     switch(input->packetId){
         case SPAWN_ENTITY:{
             entity* e = initEntity();
             e->id = readVarInt(input->data, &offset);
             e->uid = readUUID(input->data, &offset);
             e->type = readVarInt(input->data, &offset);
-            e->x = readBigEndianDouble(input->data, &offset);
-            e->y = readBigEndianDouble(input->data, &offset);
-            e->z = readBigEndianDouble(input->data, &offset);
-            e->pitch = readByte(input->data, &offset);
-            e->yaw = readByte(input->data, &offset);
-            e->headYaw = readByte(input->data, &offset);
+            if(storeEntity(output, e) != 0){
+                return -1;
+            }
+            struct entityStore* store = &output->entities;
+            double x = readBigEndianDouble(input->data, &offset);
+            double y = readBigEndianDouble(input->data, &offset);
+            double z = readBigEndianDouble(input->data, &offset);
+            if(setEntityPosition(store, e, x, y, z) != 0){
+                return -1;
+            }
+            kinematicsOf(store, e, pitch) = readByte(input->data, &offset);
+            kinematicsOf(store, e, yaw) = readByte(input->data, &offset);
+            kinematicsOf(store, e, headYaw) = readByte(input->data, &offset);
             e->data = readVarInt(input->data, &offset);
-            e->velocityX = (float)readBigEndianShort(input->data, &offset) / 8000.0;
-            e->velocityY = (float)readBigEndianShort(input->data, &offset) / 8000.0;
-            e->velocityZ = (float)readBigEndianShort(input->data, &offset) / 8000.0;
+            readEntityVelocity(store, e, input->data, &offset);
             e->linked = NULL;
-            addElement(output->entityList, (void*)e);
             event(output, spawnEntityHandler, e)
             break;
         }
@@ -195,11 +368,16 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
             entity* exp = initEntity();
             exp->id = readVarInt(input->data, &offset);
             exp->type = getEntityId(version, "minecraft:experience_orb");
-            exp->x = readBigEndianDouble(input->data, &offset);
-            exp->y = readBigEndianDouble(input->data, &offset);
-            exp->z = readBigEndianDouble(input->data, &offset);
+            if(storeEntity(output, exp) != 0){
+                return -1;
+            }
+            double x = readBigEndianDouble(input->data, &offset);
+            double y = readBigEndianDouble(input->data, &offset);
+            double z = readBigEndianDouble(input->data, &offset);
+            if(setEntityPosition(&output->entities, exp, x, y, z) != 0){
+                return -1;
+            }
             exp->data = (int32_t)readBigEndianShort(input->data, &offset);
-            addElement(output->entityList, (void*)exp);
             event(output, spawnEntityHandler, exp)
             break;
         }
@@ -208,12 +386,16 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
             player->id = readVarInt(input->data, &offset);
             player->uid = readUUID(input->data, &offset);
             player->type = getEntityId(version, "minecraft:player");
-            player->x = readBigEndianDouble(input->data, &offset);
-            player->y = readBigEndianDouble(input->data, &offset);
-            player->z = readBigEndianDouble(input->data, &offset);
-            player->yaw = readByte(input->data, &offset);
-            player->pitch = readByte(input->data, &offset);
-            addElement(output->entityList, (void*)player);
+            if(storeEntity(output, player) != 0){
+                return -1;
+            }
+            double x = readBigEndianDouble(input->data, &offset);
+            double y = readBigEndianDouble(input->data, &offset);
+            double z = readBigEndianDouble(input->data, &offset);
+            if(setEntityPosition(&output->entities, player, x, y, z) != 0){
+                return -1;
+            }
+            updateEntityRotation(&output->entities, player, input->data, &offset);
             event(output, spawnEntityHandler, player);
             break;
         }
@@ -247,68 +429,87 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
                 el = el->next;
                 struct blockChange* change = current->value;
                 if(change->sequenceId == sequenceChange){
-                    unlinkElement(current);
-                    freeListElement(current, free);
                     //TODO: handle rest of the cases
-                    if(change->status == FINISHED_DIGGING){
-                        block** b = getBlock(output, change->location);
-                        if(b != NULL){
-                            freeBlock(*b);
-                            *b = NULL;
-                        }
+                    if(change->status == FINISHED_DIGGING && setBlockState(output, change->location, AIR_STATE, version) != 0){
+                        return -1;
                     }
+                    unlinkElement(current);
+                    freeListElement(current, free);
                 }
             }
             break;
         }
         case SET_BLOCK_DESTROY_STAGE:{
-            (void)readVarInt(input->data, &offset);
+            int32_t eid = readVarInt(input->data, &offset);
             position location = (position)readBigEndianLong(input->data, &offset);
             byte stage = readByte(input->data, &offset);
-            block** b = getBlock(output, location);
-            if(b != NULL && *b != NULL){ //Air cannot have a destroy stage
+            chunk* c = getChunk(output, positionX(location) >> 4, positionZ(location) >> 4);
+            if(c != NULL){
+                listEl* el = findByLocation(c->destroyStages, location);
                 if(stage < 10){
-                    (*b)->stage = stage;
+                    struct destroyStage* d = NULL;
+                    if(el != NULL){
+                        d = el->value;
+                    }
+                    else{
+                        d = malloc(sizeof(struct destroyStage));
+                        if(d == NULL){
+                            return -1;
+                        }
+                        d->location = location;
+                        addElement(c->destroyStages, d);
+                    }
+                    d->eid = eid;
+                    d->stage = stage;
                 }
-                else{
-                    free(*b);
-                    *b = NULL;
+                else if(el != NULL){ //any other value removes the destroy stage
+                    unlinkElement(el);
+                    freeListElement(el, free);
                 }
             }
             break;
         }
         case BLOCK_ENTITY_DATA:{
-            blockEntity* bEnt = malloc(sizeof(blockEntity));
-            bEnt->location = readBigEndianLong(input->data, &offset);
-            bEnt->type = readVarInt(input->data, &offset);
-            size_t sz = nbtSize(input->data + offset, false);
-            bEnt->tag = nbt_parse(input->data + offset, sz);
-            block** b = getBlock(output, bEnt->location);
-            if(b != NULL && *b != NULL){ //Air cannot have a block entity
-                (*b)->entity = bEnt;
+            position location = readBigEndianLong(input->data, &offset);
+            chunk* c = getChunk(output, positionX(location) >> 4, positionZ(location) >> 4);
+            if(c != NULL){
+                blockEntity* bEnt = malloc(sizeof(blockEntity));
+                if(bEnt == NULL){
+                    return -1;
+                }
+                bEnt->location = location;
+                bEnt->type = readVarInt(input->data, &offset);
+                if(readNBT(input->data, &offset, bytesLeft(offset, input->size), &bEnt->tag) != 0){
+                    free(bEnt);
+                    return -2;
+                }
+                listEl* el = findByLocation(c->blockEntities, location);
+                if(el != NULL){
+                    freeBlockEntity(el->value);
+                    el->value = bEnt;
+                }
+                else{
+                    addElement(c->blockEntities, bEnt);
+                }
             }
             break;
         }
         case BLOCK_ACTION:{
             position location = (position)readBigEndianLong(input->data, &offset);
             uint16_t animationData = readBigEndianShort(input->data, &offset);
-            block** b = getBlock(output, location);
-            if(b != NULL && *b != NULL){ //air doesn't do actions i think
-                (*b)->animationData = animationData;
-                event(output, blockActionHandler, *b)
+            block b = viewBlock(output, location, version);
+            if(b.state != -1 && !stateIsAir(version, b.state)){ //air doesn't do actions i think
+                b.animationData = animationData;
+                event(output, blockActionHandler, &b)
             }
             break;
         }
         case BLOCK_UPDATE:{
             position location = (position)readBigEndianLong(input->data, &offset);
             int32_t blockId = readVarInt(input->data, &offset);
-            block** b = getBlock(output, location);
-            if(b != NULL){
-                //air can get updated
-                if(*b == NULL){
-                    *b = initBlock(positionX(location), positionY(location), positionZ(location));
-                }
-                (*b)->type = version->blockTypes.palette[blockId];
+            //air can get updated
+            if(setBlockState(output, location, blockId, version) != 0){
+                return -1;
             }
             break;
         }
@@ -373,18 +574,24 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
                 int32_t chunkX = readBigEndianInt(input->data, &offset);
                 int32_t chunkZ = readBigEndianInt(input->data, &offset);
                 int32_t limit = readVarInt(input->data, &offset) + offset;
+                if(limit < offset || limit > input->size){
+                    return -2;
+                }
                 chunk* ourChunk = getChunk(output, chunkX, chunkZ);
                 if(ourChunk != NULL){
-                    int chunkOffset = 0;
-                    for(int i = 0; i < 24; i++){
-                        if(chunkOffset >= limit){
+                    biomeContainer(biomes)
+                    for(int i = 0; i < ourChunk->sectionCount; i++){
+                        if(offset >= limit){
                             break;
                         }
                         struct section* s = ourChunk->sections + i;
-                        palettedContainer biomes = readPalettedContainer(input->data, &offset, biomePaletteLowest, biomePaletteThreshold, version->biomes.sz);
+                        if(readPalettedContainer(input->data, &offset, biomePaletteLowest, biomePaletteThreshold, version->biomes.sz, &biomes, BIOMES_NUM, limit - offset) != 0){
+                            return -2;
+                        }
                         transplantBiomes(s, biomes, version)
                     }
                 }
+                offset = limit; //the data of chunks we don't have is skipped
                 num--;
             }
             break;
@@ -431,9 +638,21 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
             slot* slots = calloc(count, sizeof(slot));
             short n = 0;
             for(short i = count; i > 0; i--){
-                slots[n] = readSlot(input->data, &offset);
+                if(readSlot(input->data, &offset, bytesLeft(offset, input->size), slots + n++) != 0){
+                    for(int32_t s = 0; s < count; s++){
+                        nbt_free(slots[s].NBT);
+                    }
+                    free(slots);
+                    return -2;
+                }
+            }
+            if(readSlot(input->data, &offset, bytesLeft(offset, input->size), &output->player.carried) != 0){
+                for(int32_t s = 0; s < count; s++){
+                    nbt_free(slots[s].NBT);
+                }
+                free(slots);
+                return -2;
             }
-            output->player.carried = readSlot(input->data, &offset);
             if(windowId == 0){ //we are dealing with player inventory
                 output->player.inventory.slotCount = count;
                 free(output->player.inventory.slots);
@@ -465,7 +684,10 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
             byte windowId = readByte(input->data, &offset);
             (void)readVarInt(input->data, &offset);
             int16_t slotId = readBigEndianShort(input->data, &offset);
-            slot data = readSlot(input->data, &offset);
+            slot data;
+            if(readSlot(input->data, &offset, bytesLeft(offset, input->size), &data) != 0){
+                return -2;
+            }
             if(slotId == 0){
                 output->player.inventory.slots[slotId] = data;
             }
@@ -525,14 +747,10 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
         }
         case ENTITY_EVENT:{
             int32_t id = readBigEndianInt(input->data, &offset);
-            listEl* el = output->entityList->first;
-            while(el != NULL){
-                entity* e = (entity*)el->value;
-                if(e != NULL && e->id == id){
-                    e->status = readByte(input->data, &offset);
-                    event(output, entityEventHandler, e);
-                }
-                el = el->next;
+            entity* e = getEntity(output, id);
+            if(e != NULL){
+                e->status = readByte(input->data, &offset);
+                event(output, entityEventHandler, e);
             }
             break;
         }
@@ -547,10 +765,8 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
                 int8_t Xoff = (int8_t)readByte(input->data, &offset);
                 int8_t Yoff = (int8_t)readByte(input->data, &offset);   
                 int8_t Zoff = (int8_t)readByte(input->data, &offset);
-                block** b = getBlock(output, toPosition((X + Xoff), (Y + Yoff), (Z + Zoff)));
-                if(b != NULL && *b != NULL){
-                    free(*b);
-                    *b = NULL;
+                if(setBlockState(output, toPosition((X + Xoff), (Y + Yoff), (Z + Zoff)), AIR_STATE, version) != 0){
+                    return -1;
                 }
                 count--;
             }
@@ -563,13 +779,7 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
         case UNLOAD_CHUNK:{
             int32_t X = readBigEndianInt(input->data, &offset);
             int32_t Z = readBigEndianInt(input->data, &offset);
-            listEl* el = output->chunks->first;
-            while(el != NULL){
-                if(((chunk*)el->value)->x == X && ((chunk*)el->value)->z == Z){
-                    unloadChunk(el);
-                }
-                el = el->next;
-            }
+            unloadChunk(output, X, Z);
             break;
         }
         case GAME_EVENT:{
@@ -617,84 +827,35 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
             break;
         }
         case CHUNK_DATA_AND_UPDATE_LIGHT:{
-            chunk* newChunk = calloc(1, sizeof(chunk));
-            newChunk->x = readBigEndianInt(input->data, &offset);
-            newChunk->z = readBigEndianInt(input->data, &offset);
-            //we skip the nbt tag
-            size_t sz = nbtSize(input->data + offset, false);
-            //nbt_node* heightmaps = nbt_parse(input->data + offset, sz);
-            offset += sz;
-            //here instead of needlessly slowing down the execution I forego using readByteArray
-            size_t byteArrayLimit = readVarInt(input->data, &offset) + offset;
-            //now we need to parse chunk data
-            for(int i = 0; i < 24; i++){ //foreach section
-                if(offset >= byteArrayLimit){ //if there are less than 24 section we need to detect that
-                    break;
+            if(output->chunkDecoder == NULL){
+                chunk* newChunk = NULL;
+                int res = decodeChunk(input->data, input->size, &newChunk, output->dimension->minY, output->dimension->height, version);
+                if(res != 0){
+                    return res;
                 }
-                struct section s = {};
-                s.y = i - 4;
-                s.nonAir = readBigEndianShort(input->data, &offset);
-                palettedContainer blocks = readPalettedContainer(input->data, &offset, blockPaletteLowest, blockPaletteThreshold, version->blockStates.sz);
-                if(blocks.palette == NULL && blocks.states == NULL){
-                    freeChunk(newChunk);
-                    return -2;
-                }
-                //and now foreach block
-                forBlocks(){
-                    //first get the state
-                    uint32_t id = 0;
-                    identifier type = NULL;
-                    if(blocks.states != NULL){
-                        id = blocks.states[statesFormula(x, y, z)];
-                        if(blocks.palette != NULL){ //apply the localPalette if necessary
-                            id = blocks.palette[id];
-                        }
-                        //and then apply the global palette and boom type gotten
-                        type = version->blockStates.palette[id];
-                    }
-                    else{
-                        id = *blocks.palette;
-                        type = version->blockStates.palette[id];
-                    }
-                    block* newBlock = NULL;
-                    if(!isAir(version, type)){
-                        //initialize the new block
-                        newBlock = initBlock(x, y, z);
-                        newBlock->entity = NULL;
-                        newBlock->animationData = 0;
-                        newBlock->stage = 0;
-                        newBlock->state = id;
-                        newBlock->type = type;
-                        newBlock->state = id;
-                    }
-                    s.blocks[x][y][z] = newBlock;
+                if(storeChunk(output, newChunk) != 0){
+                    return -1;
                 }
-                free(blocks.palette);
-                free(blocks.states);
-                palettedContainer biomes = readPalettedContainer(input->data, &offset, biomePaletteLowest, biomePaletteThreshold, version->biomes.sz);
-                transplantBiomes((&s), biomes, version)
-                free(biomes.palette);
-                free(biomes.states);
-                newChunk->sections[i] = s;
-            }
-            int32_t blockEntityCount = readVarInt(input->data, &offset);
-            for(int i = 0; i < blockEntityCount; i++){
-                blockEntity* bEnt = malloc(sizeof(blockEntity));
-                byte packedXZ = readByte(input->data, &offset);
-                uint8_t secX = packedXZ >> 4;
-                uint8_t secZ = packedXZ & 15;
-                int16_t Y = readBigEndianShort(input->data, &offset);
-                int16_t sectionId = yToSection(Y);
-                bEnt->location = toPosition(secX + (newChunk->x * 16), Y, secZ + (newChunk->z * 16));
-                bEnt->type = readVarInt(input->data, &offset);
-                size_t sizeNbt = nbtSize(input->data + offset, false);
-                bEnt->tag = nbt_parse(input->data + offset, sizeNbt);
-                offset += sizeNbt;
-                //and now we have to find the block in the chunk
-                newChunk->sections[sectionId].blocks[secX][Y - (sectionId * 16)][secZ]->entity = bEnt;
+                break;
+            }
+            if(input->size < (int32_t)(2 * sizeof(int32_t))){
+                return -2;
+            }
+            int32_t chunkX = readBigEndianInt(input->data, &offset);
+            int32_t chunkZ = readBigEndianInt(input->data, &offset);
+            //chunks outside of the window are dropped before they are decoded. Ones inside it are dropped when published if the window has moved away in the meantime
+            if(output->chunks.slots == NULL && resizeChunkGrid(output, output->viewDistance) != 0){
+                return -1;
+            }
+            if(!inChunkGrid(&output->chunks, chunkX, chunkZ)){
+                break;
+            }
+            if(chunkDecoderFull(output->chunkDecoder)){
+                publishChunks(output, 1);
+            }
+            if(submitChunk(output->chunkDecoder, chunkX, chunkZ, output->dimension->minY, output->dimension->height, input) != 0){
+                return -1;
             }
-            //MAYBE: handle the light data here
-            addElement(output->chunks, newChunk);
             break;
         }
         case WORLD_EVENT:{
@@ -734,21 +895,34 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
                 output->dimensions.arr = (identifier*)dimemsionNames.arr;
             }
             {
-                byte* nbt = input->data + offset;
-                //oh oh O(2n)... too bad I am not writing a separate parser
-                size_t sz1 = nbtSize(nbt, false);
-                nbt_node* registryCodec = nbt_parse(nbt, sz1);
-                if(registryCodec == NULL || registryCodec->type != TAG_COMPOUND){
+                //the codec is thousands of nodes, so it's kept as a flat tree that is built and freed in one go
+                nbt_view codecView = readNBTView(input->data, &offset, bytesLeft(offset, input->size));
+                if(codecView.type != TAG_COMPOUND){
+                    return -1;
+                }
+                //the registries we need are decoded once, so that looking them up later is a single array access
+                output->dimension = &defaultDimensionType;
+                freeRegistries(&output->registries);
+                int res = readRegistries(codecView, &output->registries);
+                if(res != 0){
+                    return res;
+                }
+                nbt_flat_free(output->registryCodec);
+                output->registryCodec = nbt_flat_from_view(codecView);
+                if(output->registryCodec == NULL){
                     return -1;
                 }
-                output->registryCodec = registryCodec;
-                offset += sz1;
             }
-            output->dimensionType = readString(input->data, &offset);         
+            free(output->dimensionType);
+            output->dimensionType = readString(input->data, &offset);
+            output->dimension = currentDimension(output);
             output->dimensionName = readString(input->data, &offset);   
             output->hashedSeed = readBigEndianLong(input->data, &offset);
             output->maxPlayers = readVarInt(input->data, &offset);
             output->viewDistance = readVarInt(input->data, &offset);
+            if(resizeChunkGrid(output, output->viewDistance) != 0){
+                return -1;
+            }
             output->simulationDistance = readVarInt(input->data, &offset);
             output->reducedBugInfo = readBool(input->data, &offset);
             output->respawnScreen = readBool(input->data, &offset);
@@ -765,27 +939,33 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
         }
         case UPDATE_ENTITY_POSITION:{
             int32_t eid = readVarInt(input->data, &offset);
-            entity* e = getEntity(output, eid);
+            entity* e = findEntity(&output->entities, eid);
             if(e != NULL){
-                updateEntityPosition(e, input->data, &offset);
+                if(updateEntityPosition(&output->entities, e, input->data, &offset) != 0){
+                    return -1;
+                }
+                kinematicsOf(&output->entities, e, onGround) = readBool(input->data, &offset);
             }
             break;
         }
         case UPDATE_ENTITY_POSITION_AND_ROTATION:{
             int32_t eid = readVarInt(input->data, &offset);
-            entity* e = getEntity(output, eid);
+            entity* e = findEntity(&output->entities, eid);
             if(e != NULL){
-                updateEntityPosition(e, input->data, &offset);
-                updateEntityRotation(e, input->data, &offset);
-                e->onGround = readBool(input->data, &offset);
+                if(updateEntityPosition(&output->entities, e, input->data, &offset) != 0){
+                    return -1;
+                }
+                updateEntityRotation(&output->entities, e, input->data, &offset);
+                kinematicsOf(&output->entities, e, onGround) = readBool(input->data, &offset);
             }
             break;
         }
         case UPDATE_ENTITY_ROTATION:{
             int32_t eid = readVarInt(input->data, &offset);
-            entity* e = getEntity(output, eid);
+            entity* e = findEntity(&output->entities, eid);
             if(e != NULL){
-                updateEntityRotation(e, input->data, &offset);
+                updateEntityRotation(&output->entities, e, input->data, &offset);
+                kinematicsOf(&output->entities, e, onGround) = readBool(input->data, &offset);
             }
             break;
         }
@@ -959,17 +1139,7 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
             int32_t num = readVarInt(input->data, &offset);
             while(num > 0){
                 int32_t eid = readVarInt(input->data, &offset);
-                listEl* el = output->entityList->first;
-                while(el != NULL){
-                    listEl* current = el;
-                    el = el->next;
-                    if(((entity*)current->value)->id == eid){
-                        unlinkElement(current);
-                        freeListElement(current, (freeLikeFunction)freeEntity);
-                        break;
-                    }
-                    
-                }
+                freeEntity(removeEntity(&output->entities, eid));
                 num--;
             }
             break;
@@ -1009,6 +1179,7 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
         case RESPAWN:{
             free(output->dimensionType);
             output->dimensionType = readString(input->data, &offset);
+            output->dimension = currentDimension(output);
             free(output->dimensionName);
             output->dimensionName = readString(input->data, &offset);
             output->hashedSeed = readBigEndianLong(input->data, &offset);
@@ -1041,9 +1212,9 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
         }
         case SET_HEAD_ROTATION:{
             int32_t eid = readVarInt(input->data, &offset);
-            entity* e = getEntity(output, eid);
+            entity* e = findEntity(&output->entities, eid);
             if(e != NULL){
-                e->headYaw = (angle_t)readByte(input->data, &offset); 
+                kinematicsOf(&output->entities, e, headYaw) = (angle_t)readByte(input->data, &offset); 
             }
             break;
         }
@@ -1054,21 +1225,18 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
             int32_t chunkZ = sectionPos << 22 >> 42;
             int32_t sectionY = sectionPos << 44 >> 44;
             chunk* c = getChunk(output, chunkX, chunkZ);
-            if(c != NULL){
-                struct section* s = c->sections + (sectionY + 4);
+            if(c != NULL && sectionY >= c->minSection && sectionY < c->minSection + c->sectionCount){
+                struct section* s = c->sections + (sectionY - c->minSection);
                 int32_t num = readVarInt(input->data, &offset);
                 while(num > 0){
                     int64_t ourLong = readVarLong(input->data, &offset);
                     int8_t blockY = (int8_t)(createLongMask(0, 4) & ourLong);
-                    int8_t blockZ = (int8_t)(createLongMask(5, 4) & ourLong);
-                    int8_t blockX = (int8_t)(createLongMask(9, 4) & ourLong);
+                    int8_t blockZ = (int8_t)((createLongMask(4, 4) & ourLong) >> 4);
+                    int8_t blockX = (int8_t)((createLongMask(8, 4) & ourLong) >> 8);
                     int32_t index = (int32_t)(ourLong >> 12);
-                    if(s->blocks[blockX][blockY][blockZ] == NULL){
-                        block* b = initBlock(blockX, blockY, blockZ);
-                        s->blocks[blockX][blockY][blockZ] = b;
+                    if(setSectionState(s, blockX, blockY, blockZ, index, version) != 0){
+                        return -1;
                     }
-                    s->blocks[blockX][blockY][blockZ]->type = version->blockStates.palette[index];
-                    s->blocks[blockX][blockY][blockZ]->state = index;
                     num--;
                 }
             }
@@ -1130,22 +1298,15 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
         case SET_CENTER_CHUNK:{
             int32_t chunkX = readVarInt(input->data, &offset);
             int32_t chunkZ = readVarInt(input->data, &offset);
-            if(output->player.currentChunk != NULL && output->player.currentChunk->x == chunkX && output->player.currentChunk->z == chunkZ){
-                break;
-            }
-            foreachListElement(output->chunks, el){
-                chunk* c = el->value;
-                if(c->x == chunkX && c->z == chunkZ){
-                    output->player.currentChunk = c;
-                }
-                if(c->x > chunkX + output->viewDistance || c->z > chunkZ + output->viewDistance){
-                    unloadChunk(el);
-                }
-            }
+            recenterChunkGrid(output, chunkX, chunkZ);
+            output->player.currentChunk = getChunk(output, chunkX, chunkZ);
             break;
         }
         case SET_RENDER_DISTANCE:{
             output->viewDistance = readVarInt(input->data, &offset);
+            if(resizeChunkGrid(output, output->viewDistance) != 0){
+                return -1;
+            }
             break;
         }
         case SET_DEFAULT_SPAWN_POSITION:{
@@ -1166,7 +1327,10 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
                     if(index == 0xff){
                         break;
                     }
-                    struct entityMetadata* new = parseEntityMetadata(input->data, &offset);
+                    struct entityMetadata* new = parseEntityMetadata(input->data, &offset, input->size);
+                    if(new == NULL){
+                        return -2;
+                    }
                     addElement(our->metadata, new);
                 }
             }
@@ -1185,11 +1349,9 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
         }
         case SET_ENTITY_VELOCITY:{
             int32_t eid = readVarInt(input->data, &offset);
-            entity* e = getEntity(output, eid);
+            entity* e = findEntity(&output->entities, eid);
             if(e != NULL){
-                e->velocityX = (float)readBigEndianShort(input->data, &offset) / 8000.0;
-                e->velocityY = (float)readBigEndianShort(input->data, &offset) / 8000.0;
-                e->velocityZ = (float)readBigEndianShort(input->data, &offset) / 8000.0;
+                readEntityVelocity(&output->entities, e, input->data, &offset);
             }
             break;
         }
@@ -1201,7 +1363,13 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
                 //WARNING potential for big scary invalid reads here should say something as simple as a bit flip occur.
                 while(slot & CONTINUE_BIT){
                     slot = readByte(input->data, &offset);
-                    e->items[slot & SEGMENT_BITS] = readSlot(input->data, &offset);
+                    struct slot item;
+                    if(readSlot(input->data, &offset, bytesLeft(offset, input->size), &item) != 0){
+                        return -2;
+                    }
+                    if(setEquipment(e, slot & SEGMENT_BITS, item) != 0){
+                        return -1;
+                    }
                 }
             }
             break;
@@ -1285,12 +1453,18 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
             }
             int32_t soundCategory = readVarInt(input->data, &offset);
             int32_t eid = readVarInt(input->data, &offset);
-            entity* e = getEntity(output, eid);
-            if(e != NULL){
+            entity* e = findEntity(&output->entities, eid);
+            if(e != NULL || eid == output->player.entityId){
                 float volume = readBigEndianFloat(input->data, &offset);
                 float pitch = readBigEndianFloat(input->data, &offset);
                 int64_t seed = readBigEndianLong(input->data, &offset);
-                event(output, soundEffect, soundId, soundName, range, soundCategory, (int32_t)e->x, (int32_t)e->y, (int32_t)e->z, volume, pitch, seed)
+                double X = output->player.X, Y = output->player.Y, Z = output->player.Z; //our own player isn't in the entity store
+                if(e != NULL){
+                    X = kinematicsOf(&output->entities, e, x);
+                    Y = kinematicsOf(&output->entities, e, y);
+                    Z = kinematicsOf(&output->entities, e, z);
+                }
+                event(output, soundEffect, soundId, soundName, range, soundCategory, (int32_t)X, (int32_t)Y, (int32_t)Z, volume, pitch, seed)
             }
             free(soundName);
             break;
@@ -1345,23 +1519,24 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
                 el = el->next;
                 struct nbtQuery* q = (struct nbtQuery*)current->value;
                 if(q->id == transactionId){
-                    unlinkElement(el);
-                    freeListElement(el, NULL);
-                    size_t nbtSz = nbtSize(input->data + offset, false);
-                    if(nbtSize > 0){
-                        nbt_node* tag = nbt_parse(input->data + offset, nbtSz);
-                        if(q->e != NULL){
-                            nbt_free(q->e->tag);
-                            q->e->tag = tag;
-                        }
-                        else if(q->blockEntity != NULL){
-                            nbt_free(q->blockEntity->tag);
-                            q->blockEntity->tag = tag;
-                        }
-                        else{
-                            nbt_free(tag);
-                        }
+                    nbt_node* tag = NULL;
+                    if(readNBT(input->data, &offset, bytesLeft(offset, input->size), &tag) != 0){
+                        return -2;
+                    }
+                    if(q->e != NULL){
+                        nbt_free(q->e->tag);
+                        q->e->tag = tag;
+                    }
+                    else if(q->blockEntity != NULL){
+                        nbt_free(q->blockEntity->tag);
+                        q->blockEntity->tag = tag;
+                    }
+                    else{
+                        nbt_free(tag);
                     }
+                    unlinkElement(current);
+                    freeListElement(current, free);
+                    break;
                 }
             }
             break;
@@ -1375,14 +1550,16 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
         }
         case TELEPORT_ENTITY:{
             int32_t eid = readVarInt(input->data, &offset);
-            entity* e = getEntity(output, eid);
+            entity* e = findEntity(&output->entities, eid);
             if(e != NULL){
-                e->x = readBigEndianDouble(input->data, &offset);
-                e->y = readBigEndianDouble(input->data, &offset);
-                e->z = readBigEndianDouble(input->data, &offset);
-                e->yaw = readByte(input->data, &offset);
-                e->pitch = readByte(input->data, &offset);
-                e->onGround = readBool(input->data, &offset);
+                double x = readBigEndianDouble(input->data, &offset);
+                double y = readBigEndianDouble(input->data, &offset);
+                double z = readBigEndianDouble(input->data, &offset);
+                if(setEntityPosition(&output->entities, e, x, y, z) != 0){
+                    return -1;
+                }
+                updateEntityRotation(&output->entities, e, input->data, &offset);
+                kinematicsOf(&output->entities, e, onGround) = readBool(input->data, &offset);
             }
             break;
         }
@@ -1440,15 +1617,15 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
                 new->flags = readByte(input->data, &offset);
                 new->factorDataPresent = readBool(input->data, &offset);
                 if(new->factorDataPresent){
-                    nbt_node* factorCodec = nbt_parse(input->data + offset, input->size - offset);
-                    new->factorData.paddingDuration = nbt_find_by_name(factorCodec, "padding_duration")->payload.tag_int;
-                    new->factorData.factorStart = nbt_find_by_name(factorCodec, "factor_start")->payload.tag_float;
-                    new->factorData.factorTarget = nbt_find_by_name(factorCodec, "factor_target")->payload.tag_float;
-                    new->factorData.factorCurrent = nbt_find_by_name(factorCodec, "factor_current")->payload.tag_float;
-                    new->factorData.effectChangedTimestamp = nbt_find_by_name(factorCodec, "effect_changed_timestamp")->payload.tag_int;
-                    new->factorData.factorPreviousFrame = nbt_find_by_name(factorCodec, "factor_previous_frame")->payload.tag_float;
-                    new->factorData.hadEffectLastTick = (bool)nbt_find_by_name(factorCodec, "had_effect_last_tick")->payload.tag_byte;
-                    nbt_free(factorCodec);
+                    //the codec is only read once, so it's read in place instead of being parsed into a tree
+                    nbt_view factorCodec = readNBTView(input->data, &offset, bytesLeft(offset, input->size));
+                    new->factorData.paddingDuration = nbt_view_int(nbt_view_find(factorCodec, "padding_duration"), 0);
+                    new->factorData.factorStart = nbt_view_float(nbt_view_find(factorCodec, "factor_start"), 0);
+                    new->factorData.factorTarget = nbt_view_float(nbt_view_find(factorCodec, "factor_target"), 0);
+                    new->factorData.factorCurrent = nbt_view_float(nbt_view_find(factorCodec, "factor_current"), 0);
+                    new->factorData.effectChangedTimestamp = nbt_view_int(nbt_view_find(factorCodec, "effect_changed_timestamp"), 0);
+                    new->factorData.factorPreviousFrame = nbt_view_float(nbt_view_find(factorCodec, "factor_previous_frame"), 0);
+                    new->factorData.hadEffectLastTick = (bool)nbt_view_byte(nbt_view_find(factorCodec, "had_effect_last_tick"), 0);
                 }
                 addElement(e->effects, new);
             }
@@ -1475,20 +1652,27 @@ int parsePlayPacket(packet* input, struct gamestate* output, const struct gameVe
 struct gamestate initGamestate(){
     struct gamestate g = {};
     memset(&g, 0, sizeof(struct gamestate));
-    g.entityList = initList();
-    g.chunks = initList();
     g.playerInfo = initList();
     g.queries = initList();
     g.player.playerEntity = initEntity();
     g.pendingChanges = initList();
     g.bossBars = initList();
     g.playerChat = initList();
+    g.dimension = &defaultDimensionType;
     return g;
 }
 
 void freeGamestate(struct gamestate* g){
-    freeList(g->entityList, (freeLikeFunction)freeEntity);
-    freeList(g->chunks, (freeLikeFunction)freeChunk);
+    if(g->chunkDecoder != NULL){
+        freeChunkDecoder(g->chunkDecoder);
+    }
+    freeEntityStore(&g->entities, freeEntity);
+    for(int32_t i = 0; i < g->chunks.width * g->chunks.width; i++){
+        if(g->chunks.slots[i] != NULL){
+            freeChunk(g->chunks.slots[i]);
+        }
+    }
+    free(g->chunks.slots);
     free(g->deathDimension);
     free(g->dimensionName);
     for(int i = 0; i < g->dimensions.len; i++){
@@ -1509,12 +1693,12 @@ void freeGamestate(struct gamestate* g){
     free(g->player.inventory.slots);
     free(g->player.inventory.title);
     freeList(g->playerInfo, (void(*)(void*))freeGenericPlayer);
-    nbt_free(g->registryCodec);
+    nbt_flat_free(g->registryCodec);
+    freeRegistries(&g->registries);
     free(g->serverData.icon.bytes);
     free(g->serverData.MOTD);
     freeList(g->queries, free);
     freeEntity(g->player.playerEntity);
-    freeList(g->pendingChanges, free);
     freeList(g->bossBars, (freeLikeFunction)freeBossBar);
     freeList(g->playerChat, (freeLikeFunction)freePlayerMessage);
 }
@@ -1537,44 +1721,396 @@ static int getEntityId(const struct gameVersion* version, const char* name){
     return -1;
 }
 
-static block** getBlock(struct gamestate* current, position pos){
-    int x = positionX(pos);
-    int y = positionY(pos);
-    int z = positionZ(pos);
-    short chunkX = x >> 4;
-    short chunkZ = z >> 4;
-    short sectionId = yToSection(y);
-    listEl* e = current->chunks->first;
+static struct section* getSection(struct gamestate* current, position pos, chunk** c, int* x, int* y, int* z){
+    int blockX = positionX(pos);
+    int blockY = positionY(pos);
+    int blockZ = positionZ(pos);
+    chunk* ch = getChunk(current, blockX >> 4, blockZ >> 4);
+    if(ch == NULL){
+        return NULL;
+    }
+    int sectionId = yToSection(ch, blockY);
+    if(sectionId < 0 || sectionId >= ch->sectionCount){
+        return NULL;
+    }
+    if(c != NULL){
+        *c = ch;
+    }
+    //sections are aligned to 16 blocks, so the low bits are the coordinates within the section
+    *x = blockX & 15;
+    *y = blockY & 15;
+    *z = blockZ & 15;
+    return ch->sections + sectionId;
+}
+
+static int setBlockState(struct gamestate* current, position pos, int32_t state, const struct gameVersion* version){
     chunk* c = NULL;
-    while(e != NULL){
-        chunk* ch = (chunk*)e->value;
-        if(ch->x == chunkX && ch->z == chunkZ){
-            c = ch;
-            break;
+    int x, y, z;
+    struct section* s = getSection(current, pos, &c, &x, &y, &z);
+    if(s == NULL){
+        return 0;
+    }
+    if(setSectionState(s, x, y, z, state, version) != 0){
+        return -1;
+    }
+    if(stateIsAir(version, state)){
+        listEl* el = findByLocation(c->blockEntities, pos);
+        if(el != NULL){
+            unlinkElement(el);
+            freeListElement(el, (freeLikeFunction)freeBlockEntity);
+        }
+        el = findByLocation(c->destroyStages, pos);
+        if(el != NULL){
+            unlinkElement(el);
+            freeListElement(el, free);
         }
-        e = e->next;
     }
-    if(c == NULL){
-        return NULL;
+    return 0;
+}
+
+static block viewBlock(struct gamestate* current, position pos, const struct gameVersion* version){
+    block b = {positionX(pos), positionY(pos), positionZ(pos), NULL, -1, 0, 0, NULL};
+    chunk* c = NULL;
+    int x, y, z;
+    struct section* s = getSection(current, pos, &c, &x, &y, &z);
+    if(s == NULL){
+        return b;
+    }
+    b.state = getSectionState(s, x, y, z);
+    if(b.state < version->blockStates.sz){
+        b.type = version->blockStates.palette[b.state];
+    }
+    listEl* el = findByLocation(c->blockEntities, pos);
+    if(el != NULL){
+        b.entity = el->value;
     }
-    x -= chunkX * 16;
-    z -= chunkZ * 16;
-    y -= sectionId * 16;
-    return &(c->sections[sectionId].blocks[x][y][z]);
+    el = findByLocation(c->destroyStages, pos);
+    if(el != NULL){
+        b.stage = ((struct destroyStage*)el->value)->stage;
+    }
+    return b;
 }
 
-void freeChunk(chunk* c){
-    for(uint8_t s = 0; s < 24; s++){
-        if(c->sections[s].nonAir > 0){
-            for(uint8_t x = 0; x < 16; x++){
-                for(uint8_t y = 0; y < 16; y++){
-                    for(uint8_t z = 0; z < 16; z++){
-                        freeBlock(c->sections[s].blocks[x][y][z]);
-                    }
+void advanceGamestate(struct gamestate* current, int64_t microseconds){
+    current->untickedTime += microseconds;
+    int64_t ticks = current->untickedTime / TICK_LENGTH;
+    if(ticks <= 0){
+        return;
+    }
+    current->untickedTime -= ticks * TICK_LENGTH;
+    extrapolateEntities(&current->entities, (double)ticks);
+}
+
+int32_t getBlockState(struct gamestate* current, position pos){
+    int x, y, z;
+    struct section* s = getSection(current, pos, NULL, &x, &y, &z);
+    if(s == NULL){
+        return -1;
+    }
+    return getSectionState(s, x, y, z);
+}
+
+int32_t getSectionState(const struct section* s, int x, int y, int z){
+    if(s->bitsPerEntry == 0){
+        return s->palette != NULL ? s->palette[0] : AIR_STATE; //sections the server never sent are empty
+    }
+    uint32_t perLong = 64 / s->bitsPerEntry;
+    uint32_t i = statesFormula(x, y, z);
+    uint32_t entry = (uint32_t)((s->states[i / perLong] >> ((i % perLong) * s->bitsPerEntry)) & ((1ULL << s->bitsPerEntry) - 1));
+    if(s->paletteSize == 0){
+        return (int32_t)entry;
+    }
+    return entry < s->paletteSize ? s->palette[entry] : AIR_STATE;
+}
+
+int setSectionState(struct section* s, int x, int y, int z, int32_t state, const struct gameVersion* version){
+    int32_t old = getSectionState(s, x, y, z);
+    if(old == state){
+        return 0;
+    }
+    if(s->palette == NULL && s->bitsPerEntry == 0){ //a section the server never sent, which is all air
+        s->palette = malloc(sizeof(int32_t));
+        if(s->palette == NULL){
+            return -1;
+        }
+        s->palette[0] = AIR_STATE;
+        s->paletteSize = 1;
+    }
+    uint32_t entry = (uint32_t)state;
+    if(s->paletteSize > 0){
+        uint32_t found = 0;
+        while(found < s->paletteSize && s->palette[found] != state){
+            found++;
+        }
+        if(found == s->paletteSize){ //the state isn't in the palette yet
+            if(s->bitsPerEntry == 0 || s->paletteSize == (1u << s->bitsPerEntry)){
+                uint8_t bits = s->bitsPerEntry == 0 ? blockPaletteLowest : s->bitsPerEntry + 1;
+                bool direct = bits > SECTION_MAX_PALETTE_BITS;
+                if(repackSection(s, direct ? bitsFor(version->blockStates.sz) : bits, direct) != 0){
+                    return -1;
                 }
             }
+            if(s->paletteSize > 0){
+                int32_t* newPalette = realloc(s->palette, (s->paletteSize + 1) * sizeof(int32_t));
+                if(newPalette == NULL){
+                    return -1;
+                }
+                s->palette = newPalette;
+                s->palette[s->paletteSize] = state;
+                s->paletteSize++;
+            }
+        }
+        if(s->paletteSize > 0){
+            entry = found;
         }
     }
+    uint32_t perLong = 64 / s->bitsPerEntry;
+    uint32_t i = statesFormula(x, y, z);
+    uint32_t shift = (i % perLong) * s->bitsPerEntry;
+    uint64_t mask = ((1ULL << s->bitsPerEntry) - 1) << shift;
+    s->states[i / perLong] = (s->states[i / perLong] & ~mask) | (((uint64_t)entry << shift) & mask);
+    bool wasAir = stateIsAir(version, old);
+    bool nowAir = stateIsAir(version, state);
+    if(wasAir && !nowAir){
+        s->nonAir++;
+    }
+    else if(!wasAir && nowAir && s->nonAir > 0){
+        s->nonAir--;
+    }
+    return 0;
+}
+
+static int repackSection(struct section* s, uint8_t bits, bool direct){
+    uint32_t perLong = 64 / bits;
+    uint64_t* states = calloc((STATES_NUM + perLong - 1) / perLong, sizeof(uint64_t));
+    if(states == NULL){
+        return -1;
+    }
+    uint32_t entries[STATES_NUM] = {};
+    if(s->bitsPerEntry > 0){
+        unpackEntries(s->states, s->bitsPerEntry, entries, STATES_NUM);
+    }
+    for(uint32_t i = 0; i < STATES_NUM; i++){
+        uint32_t entry = entries[i];
+        if(direct){
+            entry = entry < s->paletteSize ? (uint32_t)s->palette[entry] : AIR_STATE;
+        }
+        states[i / perLong] |= (uint64_t)entry << ((i % perLong) * bits);
+    }
+    free(s->states);
+    s->states = states;
+    s->bitsPerEntry = bits;
+    if(direct){
+        free(s->palette);
+        s->palette = NULL;
+        s->paletteSize = 0;
+    }
+    return 0;
+}
+
+static int readSection(const byte* buff, int* offset, size_t end, struct section* s, const struct gameVersion* version){
+    requireBytes(*offset, end, sizeof(int16_t) + 1)
+    s->nonAir = readBigEndianShort(buff, offset);
+    byte bits = readByte(buff, offset);
+    if(bits == 0){ //the whole section is a single state
+        s->palette = malloc(sizeof(int32_t));
+        if(s->palette == NULL){
+            return -1;
+        }
+        requireVarInt(buff, *offset, end)
+        s->palette[0] = readVarInt(buff, offset);
+        s->paletteSize = 1;
+        s->bitsPerEntry = 0;
+        requireVarInt(buff, *offset, end)
+        (void)readVarInt(buff, offset); //the empty states array
+        return 0;
+    }
+    if(bits > 32){
+        errno = EPROTO;
+        return -1;
+    }
+    if(bits >= blockPaletteThreshold){ //global state ids, packed with whatever width the server chose
+        s->paletteSize = 0;
+    }
+    else{
+        if(bits < blockPaletteLowest){
+            bits = blockPaletteLowest;
+        }
+        requireVarInt(buff, *offset, end)
+        int32_t paletteSize = readVarInt(buff, offset);
+        if(paletteSize < 1 || paletteSize > (1 << bits)){
+            errno = EPROTO;
+            return -1;
+        }
+        s->palette = malloc(paletteSize * sizeof(int32_t));
+        if(s->palette == NULL){
+            return -1;
+        }
+        for(int32_t n = 0; n < paletteSize; n++){
+            requireVarInt(buff, *offset, end)
+            int32_t element = readVarInt(buff, offset);
+            if(element < 0 || element >= version->blockStates.sz){
+                errno = E2BIG;
+                return -1;
+            }
+            s->palette[n] = element;
+        }
+        s->paletteSize = paletteSize;
+    }
+    s->bitsPerEntry = bits;
+    //the longs are kept packed, exactly as sent
+    uint32_t perLong = 64 / bits;
+    requireVarInt(buff, *offset, end)
+    int32_t numLongs = readVarInt(buff, offset);
+    if(numLongs != (int32_t)((STATES_NUM + perLong - 1) / perLong)){
+        errno = EPROTO;
+        return -1;
+    }
+    requireBytes(*offset, end, (size_t)numLongs * sizeof(uint64_t))
+    s->states = malloc(numLongs * sizeof(uint64_t));
+    if(s->states == NULL){
+        return -1;
+    }
+    for(int32_t l = 0; l < numLongs; l++){
+        s->states[l] = readBigEndianULong(buff, offset);
+    }
+    return 0;
+}
+
+int decodeChunk(const byte* data, size_t size, chunk** out, int32_t minY, int32_t height, const struct gameVersion* version){
+    if(size < 2 * sizeof(int32_t)){
+        return -2;
+    }
+    int offset = 0;
+    int32_t chunkX = readBigEndianInt(data, &offset);
+    int32_t chunkZ = readBigEndianInt(data, &offset);
+    chunk* newChunk = initChunk(chunkX, chunkZ, minY, height);
+    if(newChunk == NULL){
+        return -1;
+    }
+    errno = 0;
+    if(readChunkData(data, size, newChunk, version) != 0){
+        freeChunk(newChunk);
+        return errno == ENOMEM ? -1 : -2;
+    }
+    *out = newChunk;
+    return 0;
+}
+
+static int readChunkData(const byte* data, size_t size, chunk* c, const struct gameVersion* version){
+    int offset = 2 * sizeof(int32_t); //past the chunk coordinates
+    //we skip the heightmaps, which are validated against the payload size while skipping them
+    nbt_view heightmaps = readNBTView(data, &offset, size - offset);
+    if(heightmaps.type != TAG_COMPOUND){
+        errno = EPROTO;
+        return -1;
+    }
+    //here instead of needlessly slowing down the execution I forego using readByteArray
+    requireVarInt(data, offset, size)
+    int32_t byteArraySize = readVarInt(data, &offset);
+    requireBytes(offset, size, byteArraySize)
+    size_t byteArrayLimit = (size_t)offset + byteArraySize;
+    biomeContainer(biomes)
+    //now we need to parse chunk data
+    for(int i = 0; i < c->sectionCount; i++){ //foreach section
+        if(offset >= byteArrayLimit){ //if the server sent fewer sections we need to detect that
+            break;
+        }
+        struct section* s = c->sections + i;
+        if(readSection(data, &offset, byteArrayLimit, s, version) != 0){
+            return -1;
+        }
+        if(readPalettedContainer(data, &offset, biomePaletteLowest, biomePaletteThreshold, version->biomes.sz, &biomes, BIOMES_NUM, byteArrayLimit - offset) != 0){
+            return -1;
+        }
+        transplantBiomes(s, biomes, version)
+    }
+    offset = byteArrayLimit;
+    requireVarInt(data, offset, size)
+    int32_t blockEntityCount = readVarInt(data, &offset);
+    for(int i = 0; i < blockEntityCount; i++){
+        requireBytes(offset, size, 1 + sizeof(int16_t))
+        byte packedXZ = readByte(data, &offset);
+        uint8_t secX = packedXZ >> 4;
+        uint8_t secZ = packedXZ & 15;
+        int16_t Y = readBigEndianShort(data, &offset);
+        requireVarInt(data, offset, size)
+        int32_t type = readVarInt(data, &offset);
+        nbt_node* tag = NULL;
+        if(readNBT(data, &offset, bytesLeft(offset, size), &tag) != 0){
+            return -1;
+        }
+        blockEntity* bEnt = malloc(sizeof(blockEntity));
+        if(bEnt == NULL){
+            nbt_free(tag);
+            errno = ENOMEM;
+            return -1;
+        }
+        bEnt->location = toPosition(secX + (c->x * 16), Y, secZ + (c->z * 16));
+        bEnt->type = type;
+        bEnt->tag = tag;
+        //block entities are kept in a sparse table instead of on the blocks
+        addElement(c->blockEntities, bEnt);
+    }
+    //MAYBE: handle the light data here
+    return 0;
+}
+
+static listEl* findByLocation(listHead* table, position location){
+    foreachListElement(table, el){
+        //both blockEntity and destroyStage start with their location
+        if(*(position*)el->value == location){
+            return el;
+        }
+    }
+    return NULL;
+}
+
+static chunk* initChunk(int32_t x, int32_t z, int32_t minY, int32_t height){
+    chunk* c = calloc(1, sizeof(chunk));
+    if(c == NULL){
+        return NULL;
+    }
+    c->x = x;
+    c->z = z;
+    c->minSection = minY >> 4;
+    c->sectionCount = height >> 4;
+    c->sections = calloc(c->sectionCount, sizeof(struct section));
+    if(c->sections == NULL){
+        free(c);
+        return NULL;
+    }
+    for(int i = 0; i < c->sectionCount; i++){
+        c->sections[i].y = c->minSection + i;
+    }
+    c->blockEntities = initList();
+    c->destroyStages = initList();
+    return c;
+}
+
+static bool stateIsAir(const struct gameVersion* version, int32_t state){
+    if(state < 0 || state >= version->blockStates.sz){
+        return true;
+    }
+    return isAirState(version, state);
+}
+
+static uint8_t bitsFor(size_t n){
+    uint8_t bits = 0;
+    while(((size_t)1 << bits) < n){
+        bits++;
+    }
+    return bits;
+}
+
+void freeChunk(chunk* c){
+    for(uint16_t s = 0; s < c->sectionCount; s++){
+        free(c->sections[s].palette);
+        free(c->sections[s].states);
+    }
+    free(c->sections);
+    freeList(c->blockEntities, (freeLikeFunction)freeBlockEntity);
+    freeList(c->destroyStages, free);
     free(c);
 }
 
@@ -1626,26 +2162,123 @@ static entity* getEntity(struct gamestate* current, int32_t eid){
     if(eid == current->player.entityId){
         return current->player.playerEntity;
     }
-    listEl* el = current->entityList->first;
-    while(el != NULL){
-        entity* e = (entity*)el->value;
-        if(e != NULL && e->id == eid){
-            return e;
+    return findEntity(&current->entities, eid);
+}
+
+static int storeEntity(struct gamestate* current, entity* e){
+    //a respawned entity replaces the one we knew under the same id
+    freeEntity(removeEntity(&current->entities, e->id));
+    if(addEntity(&current->entities, e) != 0){
+        freeEntity(e);
+        return -1;
+    }
+    return 0;
+}
+
+static void unloadChunk(struct gamestate* current, int32_t chunkX, int32_t chunkZ){
+    if(getChunk(current, chunkX, chunkZ) != NULL){
+        evictChunk(current, chunkSlot(&current->chunks, chunkX, chunkZ));
+    }
+}
+
+static inline chunk** chunkSlot(const struct chunkGrid* grid, int32_t chunkX, int32_t chunkZ){
+    int32_t x = chunkX % grid->width;
+    int32_t z = chunkZ % grid->width;
+    if(x < 0){
+        x += grid->width;
+    }
+    if(z < 0){
+        z += grid->width;
+    }
+    return grid->slots + (x * grid->width + z);
+}
+
+static inline bool inChunkGrid(const struct chunkGrid* grid, int32_t chunkX, int32_t chunkZ){
+    int32_t range = grid->width / 2;
+    return abs(chunkX - grid->centerX) <= range && abs(chunkZ - grid->centerZ) <= range;
+}
+
+static void evictChunk(struct gamestate* current, chunk** slot){
+    if(current->player.currentChunk == *slot){
+        current->player.currentChunk = NULL;
+    }
+    freeChunk(*slot);
+    *slot = NULL;
+    current->chunks.loaded--;
+}
+
+static int storeChunk(struct gamestate* current, chunk* c){
+    struct chunkGrid* grid = &current->chunks;
+    if(grid->slots == NULL && resizeChunkGrid(current, current->viewDistance) != 0){
+        freeChunk(c);
+        return -1;
+    }
+    if(!inChunkGrid(grid, c->x, c->z)){ //the vanilla client drops these too
+        freeChunk(c);
+        return 0;
+    }
+    chunk** slot = chunkSlot(grid, c->x, c->z);
+    if(*slot != NULL){ //either a resend of this chunk, or one that left the window
+        evictChunk(current, slot);
+    }
+    *slot = c;
+    grid->loaded++;
+    if(c->x == grid->centerX && c->z == grid->centerZ){
+        current->player.currentChunk = c;
+    }
+    return 0;
+}
+
+static int resizeChunkGrid(struct gamestate* current, int32_t viewDistance){
+    struct chunkGrid* grid = &current->chunks;
+    int32_t width = 2 * ((viewDistance > MIN_VIEW_DISTANCE ? viewDistance : MIN_VIEW_DISTANCE) + CHUNK_GRID_MARGIN) + 1;
+    if(width == grid->width){
+        return 0;
+    }
+    chunk** slots = calloc(width * width, sizeof(chunk*));
+    if(slots == NULL){
+        return -1;
+    }
+    struct chunkGrid old = *grid;
+    grid->slots = slots;
+    grid->width = width;
+    grid->loaded = 0;
+    for(int32_t i = 0; i < old.width * old.width; i++){
+        chunk* c = old.slots[i];
+        if(c == NULL){
+            continue;
+        }
+        //within the window every chunk maps to it's own slot, so nothing collides
+        if(inChunkGrid(grid, c->x, c->z)){
+            *chunkSlot(grid, c->x, c->z) = c;
+            grid->loaded++;
+        }
+        else{
+            if(current->player.currentChunk == c){
+                current->player.currentChunk = NULL;
+            }
+            freeChunk(c);
         }
-        el = el->next;
     }
-    return NULL;
+    free(old.slots);
+    return 0;
 }
 
-static void unloadChunk(listEl* el){
-    chunk* c = el->value;
-    if(c != NULL){
-        unlinkElement(el);
-        freeListElement(el, (freeLikeFunction)freeChunk);
+static void recenterChunkGrid(struct gamestate* current, int32_t chunkX, int32_t chunkZ){
+    struct chunkGrid* grid = &current->chunks;
+    if(grid->centerX == chunkX && grid->centerZ == chunkZ){
+        return;
+    }
+    grid->centerX = chunkX;
+    grid->centerZ = chunkZ;
+    for(int32_t i = 0; i < grid->width * grid->width; i++){
+        if(grid->slots[i] != NULL && !inChunkGrid(grid, grid->slots[i]->x, grid->slots[i]->z)){
+            evictChunk(current, grid->slots + i);
+        }
     }
 }
 
-static struct entityMetadata* parseEntityMetadata(byte* input, int* offset){
+static struct entityMetadata* parseEntityMetadata(byte* input, int* offset, size_t size){
     struct entityMetadata* new = malloc(sizeof(struct entityMetadata));
     new->type = readVarInt(input, offset);
     switch(new->type){
@@ -1684,7 +2317,10 @@ static struct entityMetadata* parseEntityMetadata(byte* input, int* offset){
             break;
         }
         case SLOT:{
-            new->value.SLOT = readSlot(input, offset);
+            if(readSlot(input, offset, bytesLeft(*offset, size), &new->value.SLOT) != 0){
+                free(new);
+                return NULL;
+            }
             break;
         }
         case BOOLEAN:{
@@ -1728,9 +2364,10 @@ static struct entityMetadata* parseEntityMetadata(byte* input, int* offset){
             break;
         }
         case NBT:{
-            size_t sz = nbtSize(input + *offset, false);
-            new->value.NBT = nbt_parse(input + *offset, sz);
-            offset += sz;
+            if(readNBT(input, offset, bytesLeft(*offset, size), &new->value.NBT) != 0){
+                free(new);
+                return NULL;
+            }
             break;
         }
         case PARTICLE:{
@@ -1790,14 +2427,6 @@ static struct entityMetadata* parseEntityMetadata(byte* input, int* offset){
     return new;
 }
 
-static bool isAir(const struct gameVersion* current, const identifier type){
-    bool result = false;
-    for(int i = 0; i < current->airTypes.sz; i++){
-        result |= strcmp(current->airTypes.palette[i], type) == 0;
-    }
-    return result;
-}
-
 struct gameVersion* createVersionStruct(const char* versionJSON, const char* biomesJSON, uint32_t protocol){
     //first we need to parse the json
     char* jsonContents = NULL;
@@ -1816,7 +2445,7 @@ struct gameVersion* createVersionStruct(const char* versionJSON, const char* bio
     if(version == NULL){
         return NULL;
     }
-    struct gameVersion* thisVersion = malloc(sizeof(struct gameVersion));
+    struct gameVersion* thisVersion = calloc(1, sizeof(struct gameVersion));
     {//create a lookup table for entities
         cJSON* entities = cJSON_GetObjectItemCaseSensitive(version, "entities");
         thisVersion->entities.sz = cJSON_GetArraySize(entities);
@@ -1826,13 +2455,16 @@ struct gameVersion* createVersionStruct(const char* versionJSON, const char* bio
         for(int i = 0; i < thisVersion->entities.sz; i++){
             cJSON* id = cJSON_GetObjectItemCaseSensitive(child, "id");
             if(id != NULL){
-                thisVersion->entities.palette[id->valueint] = child->valuestring;
+                thisVersion->entities.palette[id->valueint] = mCpyAlloc(child->string, strlen(child->string) + 1);
                 num++;
             }
             child = child->next;
         }
         //downsize the array if necessary
         if(thisVersion->entities.sz != num){
+            for(int i = num; i < thisVersion->entities.sz; i++){
+                free(thisVersion->entities.palette[i]);
+            }
             if(num != 0){
                 thisVersion->entities.palette = realloc(thisVersion->entities.palette, num * sizeof(identifier));
             }
@@ -1860,6 +2492,9 @@ struct gameVersion* createVersionStruct(const char* versionJSON, const char* bio
         cJSON* lastState = cJSON_GetArrayItem(lastStates, cJSON_GetArraySize(lastStates) - 1);
         thisVersion->blockStates.sz = atoi(lastState->string) + 1;
         thisVersion->blockStates.palette = calloc(thisVersion->blockStates.sz, sizeof(identifier));
+        //dense per state tables, so that hot paths never have to compare names
+        thisVersion->airStates = calloc((thisVersion->blockStates.sz + 63) / 64, sizeof(uint64_t));
+        thisVersion->stateTypes = calloc(thisVersion->blockStates.sz, sizeof(int32_t));
         thisVersion->airTypes.sz = 0; //now this is the index of the air array
         thisVersion->airTypes.palette = NULL;
         cJSON* child = blocks->child;
@@ -1867,19 +2502,27 @@ struct gameVersion* createVersionStruct(const char* versionJSON, const char* bio
             cJSON* id = cJSON_GetObjectItemCaseSensitive(child, "id");
             char* name = mCpyAlloc(child->string, strlen(child->string) + 1);
             thisVersion->blockTypes.palette[id->valueint] = name;
+            cJSON* class = cJSON_GetObjectItemCaseSensitive(child, "class");
+            bool air = class != NULL && strcmp(class->valuestring, mcAirClass) == 0;
+            if(air){
+                thisVersion->airTypes.palette = realloc(thisVersion->airTypes.palette, (thisVersion->airTypes.sz + 1) * sizeof(identifier));
+                thisVersion->airTypes.palette[thisVersion->airTypes.sz] = name;
+                thisVersion->airTypes.sz++;
+            }
             cJSON* states = cJSON_GetObjectItemCaseSensitive(child, "states");
             size_t statesSz = cJSON_GetArraySize(states);
             cJSON* state = states->child;
             for(int s = 0; s < statesSz; s++){
-                thisVersion->blockStates.palette[atoi(state->string)] = name;
+                int stateId = atoi(state->string);
+                if(stateId >= 0 && stateId < thisVersion->blockStates.sz){
+                    thisVersion->blockStates.palette[stateId] = name;
+                    thisVersion->stateTypes[stateId] = id->valueint;
+                    if(air){
+                        thisVersion->airStates[stateId >> 6] |= 1ULL << (stateId & 63);
+                    }
+                }
                 state = state->next;
             }
-            cJSON* class = cJSON_GetObjectItemCaseSensitive(child, "class");
-            if(class != NULL && strcmp(class->valuestring, "AirBlock") == 0){
-                thisVersion->airTypes.palette = realloc(thisVersion->airTypes.palette, (thisVersion->airTypes.sz + 1) * sizeof(identifier));
-                thisVersion->airTypes.palette[thisVersion->airTypes.sz] = name;
-                thisVersion->airTypes.sz++;
-            }
             child = child->next;
         }
     }
@@ -1892,8 +2535,8 @@ struct gameVersion* createVersionStruct(const char* versionJSON, const char* bio
         fseek(json, 0, SEEK_END);
         biomesContentSize = ftell(json);
         fseek(json, 0, SEEK_SET);
-        biomesContent = calloc(sz + 1, 1);
-        fread(biomesContent, sz, 1, json);
+        biomesContent = calloc(biomesContentSize + 1, 1);
+        fread(biomesContent, biomesContentSize, 1, json);
         fclose(json);
     }
     cJSON* biomes = cJSON_ParseWithLength(biomesContent, biomesContentSize);
@@ -1912,7 +2555,10 @@ struct gameVersion* createVersionStruct(const char* versionJSON, const char* bio
 }
 
 void freeVersionStruct(struct gameVersion* version){
-    if(version != NULL){
+    if(version != NULL && version->cache != NULL){
+        freeVersionCache(version); //the names live in the mapping
+    }
+    else if(version != NULL){
         for(int i = 0; i < version->blockTypes.sz; i++){
             free(version->blockTypes.palette[i]);
         }
@@ -1923,6 +2569,11 @@ void freeVersionStruct(struct gameVersion* version){
         }
         free(version->biomes.palette);
         free(version->airTypes.palette);
+        free(version->airStates);
+        free(version->stateTypes);
+        for(int i = 0; i < version->entities.sz; i++){
+            free(version->entities.palette[i]);
+        }
         free(version->entities.palette);
         free(version);
     }
@@ -1935,13 +2586,6 @@ static void freeBlockEntity(blockEntity* e){
     }
 }
 
-static void freeBlock(block* b){
-    if(b != NULL){
-        freeBlockEntity(b->entity);
-        free(b);
-    }
-}
-
 static void freeProperty(struct property* p){
     if(p != NULL){
         free(p->name);
@@ -1966,18 +2610,63 @@ void* mCpyAlloc(const void* value, size_t size){
     return res;
 }
 
-static chunk* getChunk(const struct gamestate* current, int32_t chunkX, int32_t chunkZ){
-    chunk* res = NULL;
-    foreachListElement(current->chunks, el){
-        chunk* c = el->value;
-        if(c != NULL && c->x == chunkX && c->z == chunkZ){
-            res = c;
-            break;
-        }
+int startChunkDecoding(struct gamestate* current, const struct gameVersion* version, int threads){
+    if(current->chunkDecoder != NULL){
+        errno = EALREADY;
+        return -1;
     }
+    current->chunkDecoder = initChunkDecoder(version, threads);
+    return current->chunkDecoder != NULL ? 0 : -1;
+}
+
+int stopChunkDecoding(struct gamestate* current){
+    if(current->chunkDecoder == NULL){
+        return 0;
+    }
+    publishChunks(current, getChunkDecoderStats(current->chunkDecoder).pending);
+    int res = freeChunkDecoder(current->chunkDecoder);
+    current->chunkDecoder = NULL;
     return res;
 }
 
+static void publishChunks(struct gamestate* current, size_t count){
+    while(true){
+        chunk* c = NULL;
+        int res = takeDecodedChunk(current->chunkDecoder, count > 0, &c);
+        if(res > 0){
+            return;
+        }
+        if(count > 0){
+            count--;
+        }
+        if(res == 0){
+            storeChunk(current, c); //frees the chunk on failure
+        }
+    }
+}
+
+static const struct dimensionType* currentDimension(const struct gamestate* current){
+    const struct dimensionType* d = findDimensionType(&current->registries, current->dimensionType);
+    return d != NULL ? d : &defaultDimensionType;
+}
+
+static chunk* getChunk(struct gamestate* current, int32_t chunkX, int32_t chunkZ){
+    if(current->chunkDecoder != NULL){
+        size_t depth = pendingChunkDepth(current->chunkDecoder, chunkX, chunkZ);
+        if(depth > 0){
+            publishChunks(current, depth);
+        }
+    }
+    if(current->chunks.slots == NULL){
+        return NULL;
+    }
+    chunk* c = *chunkSlot(&current->chunks, chunkX, chunkZ);
+    if(c != NULL && c->x == chunkX && c->z == chunkZ){
+        return c;
+    }
+    return NULL;
+}
+
 entity* initEntity(){
     entity* new = calloc(1, sizeof(entity));
     new->metadata = initList();
@@ -1993,22 +2682,69 @@ static void freeEntity(entity* e){
         }
         freeList(e->effects, free);
         free(e->attributes);
-        for(int i = 0; i < MAX_ENT_SLOT_COUNT; i++){
-            nbt_free(e->items[i].NBT);
+        for(int i = 0; i < e->equipmentCount; i++){
+            nbt_free(e->equipment[i].item.NBT);
         }
+        free(e->equipment);
         free(e);
     }
 }
 
-static inline void updateEntityPosition(entity* e, const byte* buff, int* index){
-    e->x += (double)deltaShortFormula(readBigEndianShort(buff, index));
-    e->y += (double)deltaShortFormula(readBigEndianShort(buff, index));
-    e->z += (double)deltaShortFormula(readBigEndianShort(buff, index));
+const slot* getEquipment(const entity* e, byte equipmentSlot){
+    for(int i = 0; i < e->equipmentCount; i++){
+        if(e->equipment[i].slot == equipmentSlot){
+            return &e->equipment[i].item;
+        }
+    }
+    return NULL;
 }
 
-static inline void updateEntityRotation(entity* e, const byte* buff, int* index){
-    e->yaw = readByte(buff, index);
-    e->pitch = readByte(buff, index);
+static int setEquipment(entity* e, byte equipmentSlot, slot item){
+    int i = 0;
+    while(i < e->equipmentCount && e->equipment[i].slot != equipmentSlot){
+        i++;
+    }
+    if(i < e->equipmentCount){ //the slot is taken, so the old item goes
+        nbt_free(e->equipment[i].item.NBT);
+        if(!item.present){
+            e->equipmentCount--;
+            e->equipment[i] = e->equipment[e->equipmentCount];
+            return 0;
+        }
+    }
+    else{
+        if(!item.present){
+            return 0;
+        }
+        struct equipment* equipment = realloc(e->equipment, (e->equipmentCount + 1) * sizeof(struct equipment));
+        if(equipment == NULL){
+            nbt_free(item.NBT);
+            return -1;
+        }
+        e->equipment = equipment;
+        e->equipmentCount++;
+    }
+    e->equipment[i].slot = equipmentSlot;
+    e->equipment[i].item = item;
+    return 0;
+}
+
+static inline int updateEntityPosition(struct entityStore* store, entity* e, const byte* buff, int* index){
+    double dx = deltaShortFormula(readBigEndianShort(buff, index));
+    double dy = deltaShortFormula(readBigEndianShort(buff, index));
+    double dz = deltaShortFormula(readBigEndianShort(buff, index));
+    return moveEntity(store, e, dx, dy, dz);
+}
+
+static inline void updateEntityRotation(struct entityStore* store, const entity* e, const byte* buff, int* index){
+    kinematicsOf(store, e, yaw) = readByte(buff, index);
+    kinematicsOf(store, e, pitch) = readByte(buff, index);
+}
+
+static inline void readEntityVelocity(struct entityStore* store, const entity* e, const byte* buff, int* index){
+    kinematicsOf(store, e, velocityX) = (double)readBigEndianShort(buff, index) / 8000.0;
+    kinematicsOf(store, e, velocityY) = (double)readBigEndianShort(buff, index) / 8000.0;
+    kinematicsOf(store, e, velocityZ) = (double)readBigEndianShort(buff, index) / 8000.0;
 }
 
 static void freeEntityAttribute(struct entityAttribute* eA){
@@ -2027,14 +2763,6 @@ static void freeContainer(struct container* c){
     }
 }
 
-static block* initBlock(int32_t x, int32_t y, int32_t z){
-    block* new = calloc(1, sizeof(block));
-    new->x = x;
-    new->y = y;
-    new->z = z;
-    return new;
-}
-
 static struct title* initTitle(){
     struct title* new = calloc(1, sizeof(struct title));
     return new;
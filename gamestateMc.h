@@ -6,13 +6,21 @@
 
 #include "mcTypes.h"
 #include "list.h"
+#include "entityStoreMc.h"
+#include "chunkDecoderMc.h"
+#include "registryMc.h"
 
 #include "cNBT/nbt.h"
 #include "cJSON/cJSON.h"
 
 //https://gitlab.bixilon.de/bixilon/pixlyzer-data/-/tree/master/version
 
-#define MAX_ENT_SLOT_COUNT 128
+#define MIN_VIEW_DISTANCE 2 //the chunk grid is never smaller than this view distance
+#define CHUNK_GRID_MARGIN 3 //chunks kept loaded beyond the view distance, just like the vanilla client does
+
+#define SECTION_MAX_PALETTE_BITS 8 //above this many bits per entry a section stores global state ids directly, just like the protocol does
+#define AIR_STATE 0 //the global block state id of minecraft:air
+#define TICK_LENGTH 50000 //the length of a game tick in microseconds
 
 //Types
 
@@ -164,32 +172,34 @@ struct entityEffect{
 //Minecraft entity
 typedef struct entity entity;
 
+//An item worn or held by an entity
+struct equipment{
+    byte slot; //0 main hand, 1 off hand, 2 boots, 3 leggings, 4 chestplate, 5 helmet
+    slot item;
+};
+
+//Position, rotation and velocity are kept in the kinematics of the entityStore, see kinematicsOf
 struct entity{
     int32_t id; 
     UUID_t uid; //Unique id of this entity
     uint8_t type; //id of entity class
-    double x;
-    double y;
-    double z;
-    angle_t pitch;
-    angle_t yaw;
-    angle_t headYaw;
-    bool onGround;
     int32_t data;
-    float velocityX;
-    float velocityY;
-    float velocityZ;
     uint8_t animation;
     byte status;
     listHead* metadata;
     entity* linked; //The entity holding this entity
     struct entityAttribute* attributes;
     size_t attributeCount;
-    slot items[MAX_ENT_SLOT_COUNT]; //MAYBE optimize the storage for items of entities
+    struct equipment* equipment; //only the occupied equipment slots, allocated once the entity gets equipment. See getEquipment
+    uint8_t equipmentCount;
     listHead* effects;
     size_t passengerCount;
     entity** passengers;
     nbt_node* tag;
+    uint32_t storeIndex; //where the entity sits in the entityStore, maintained by it
+    uint32_t typeIndex; //where the entity sits in the entityStore array of it's type, maintained by it
+    uint64_t cell; //the spatial hash cell the entity is in, maintained by the entityStore
+    uint32_t cellIndex; //where the entity sits in that cell, maintained by the entityStore
 };
 
 typedef enum block_faces{
@@ -228,8 +238,7 @@ struct container{
     int16_t flags[9];
 };
 
-//I am not certain if a list is the best choice for storing chunks, but it handles deletion and appending the best out of all the things i can think of
-
+//A snapshot of a single block, put together from the section it's in and the side tables of it's chunk
 typedef struct block{
     int32_t x;
     int32_t y;
@@ -241,20 +250,52 @@ typedef struct block{
     blockEntity* entity; //the associated blockEntity
 } block;
 
+//Blocks are stored just like the protocol sends them: a local palette of global state ids and bit packed indices into it
 struct section{
-    int8_t y; //The y index of this section going from -4 to plus 19
+    int8_t y; //The y index of this section, going from -4 to plus 19 in the overworld
     uint16_t nonAir;
-    block* blocks[16][16][16]; //NULLable array of blocks, NULL meaning it's an air block
+    uint8_t bitsPerEntry; //0 if every block in the section is palette[0]
+    uint16_t paletteSize; //0 if states holds global state ids instead of palette indices
+    int32_t* palette; //local palette of global block state ids
+    uint64_t* states; //packed entries in statesFormula order, 64 / bitsPerEntry of them per long. NULL if bitsPerEntry is 0
     identifier biome[64]; //Encoded biome regions, each having a size of 4x4x4
 };
 
-//A Minecraft chunk column, consisting of a maximum of 24 sections
+//A block that is being broken
+struct destroyStage{
+    position location; //first, just like in blockEntity, so that both side tables are searched the same way
+    int32_t eid; //the entity breaking the block
+    byte stage; //0 to 9
+};
+
+//A Minecraft chunk column, consisting of as many sections as the dimension it's in is tall
 typedef struct chunk{
     int32_t x;
     int32_t z;
-    struct section sections[24];
+    int16_t minSection; //the y index of sections[0]
+    uint16_t sectionCount;
+    struct section* sections;
+    listHead* blockEntities; //sparse table of the blockEntities within this chunk
+    listHead* destroyStages; //sparse table of the blocks within this chunk that are being broken
 } chunk;
 
+/*!
+ @struct chunkGrid
+ @brief The chunks loaded around the center chunk, kept in a ring buffer indexed by chunk coordinates modulo it's width, so that finding a chunk never has to search
+ @param slots width * width chunk pointers, NULL where no chunk is loaded
+ @param width the number of chunks along each side of the window. 0 until the first chunk arrives
+ @param centerX the x coordinate of the center chunk
+ @param centerZ the z coordinate of the center chunk
+ @param loaded the number of loaded chunks
+*/
+struct chunkGrid{
+    chunk** slots;
+    int32_t width;
+    int32_t centerX;
+    int32_t centerZ;
+    size_t loaded;
+};
+
 //Minecraft gameplay difficulty
 typedef enum difficulty_levels{
     UNDEFINED = -1,
@@ -374,10 +415,13 @@ struct gamestate{
     } player;
     int64_t worldAge;
     int64_t timeOfDay;
+    int64_t untickedTime; //microseconds that passed since the last client tick, see advanceGamestate
     bool hardcore;
     identifierArray dimensions;
-    struct nbt_node* registryCodec;
+    nbt_flat_tree* registryCodec; //flat copy of the whole registry codec from LOGIN_PLAY, for looking up the registries that aren't decoded with nbt_flat_find_by_path
+    struct registries registries; //the registries we need, decoded from the registry codec
     identifier dimensionType; //current dimension type
+    const struct dimensionType* dimension; //the properties of the current dimension type, never NULL
     identifier dimensionName;
     int64_t hashedSeed;
     int maxPlayers;
@@ -392,10 +436,11 @@ struct gamestate{
     position death;
     int portalCooldown;
     bool loginPlay; //if we can send packets back during play
-    listHead* entityList;
+    struct entityStore entities; //every tracked entity other than our own player
     listHead* pendingChanges;
     listHead* queries; //list of nbt tag queries
-    listHead* chunks;
+    struct chunkGrid chunks;
+    struct chunkDecoder* chunkDecoder; //worker pool chunk packets are decoded on, or NULL to decode them while parsing
     difficulty_t difficulty;
     bool difficultyLocked;
     struct container* openContainer; //so in theory there can be more than one open container, but the vanilla client doesn't do that
@@ -462,6 +507,10 @@ struct gameVersion{
     struct palette blockStates;
     struct palette biomes;
     struct palette airTypes;
+    uint64_t* airStates; //bitmap of the block states that are air, indexed by global state id
+    int32_t* stateTypes; //the blockTypes index of every global state id
+    void* cache; //the mapped version cache the names and tables point into, or NULL if they were allocated from the json
+    size_t cacheSize;
 };
 
 //Macros
@@ -478,7 +527,11 @@ struct gameVersion{
         for(int y = 0; y < 16; y++)\
             for(int z = 0; z < 16; z++)
 
-#define yToSection(y) (y + (4 * 16)) >> 4
+//Gets the index into the sections of a chunk of the section holding the block y coordinate
+#define yToSection(c, y) (((y) >> 4) - (c)->minSection)
+
+//Checks if the global block state id, which must be below blockStates.sz, is air with a single lookup
+#define isAirState(version, state) (((version)->airStates[(uint32_t)(state) >> 6] >> ((uint32_t)(state) & 63)) & 1)
 
 //Functions
 
@@ -507,13 +560,86 @@ void freeGamestate(struct gamestate* g);
 */
 void freeChunk(chunk* c);
 
+/*!
+ @brief Decodes the payload of a CHUNK_DATA_AND_UPDATE_LIGHT packet into a chunk that isn't part of any gamestate. Safe to call from any thread
+ @param data the packet payload
+ @param size the size of the payload, which is never read past
+ @param out pointer to where the new chunk should be stored
+ @param minY the lowest block y coordinate of the dimension the chunk is in, a multiple of 16
+ @param height the height of that dimension, a positive multiple of 16
+ @param version pointer to a struct that defines all game version dependant constants
+ @return 0 on success, -1 for error, -2 if the packet is malformed
+*/
+int decodeChunk(const byte* data, size_t size, chunk** out, int32_t minY, int32_t height, const struct gameVersion* version);
+
+/*!
+ @brief Moves the decoding of chunk packets onto a pool of worker threads. Decoded chunks are published into the gamestate in packet order, and block lookups wait for the chunk they touch
+ @param current the gamestate
+ @param version the version the chunks are decoded with, which must outlive the decoding
+ @param threads the number of worker threads
+ @return 0 on success, -1 for error
+*/
+int startChunkDecoding(struct gamestate* current, const struct gameVersion* version, int threads);
+
+/*!
+ @brief Waits for every pending chunk packet to be decoded and published, then stops the worker threads. Has to be called before the version is freed
+ @param current the gamestate
+ @return 0 on success, -1 for error
+*/
+int stopChunkDecoding(struct gamestate* current);
+
+/*!
+ @brief Lets time pass in the gamestate. Once at least a whole tick passed the client tick runs, which extrapolates the positions of the entities
+ @param current the gamestate
+ @param microseconds the time that passed since the previous call
+*/
+void advanceGamestate(struct gamestate* current, int64_t microseconds);
+
+/*!
+ @brief Gets the item in an equipment slot of the entity
+ @param e the entity
+ @param equipmentSlot the equipment slot
+ @return the item, or NULL if the slot is empty
+*/
+const slot* getEquipment(const entity* e, byte equipmentSlot);
+
+/*!
+ @brief Gets the global block state id at the given position within the section
+ @param s the section
+ @param x the x coordinate within the section
+ @param y the y coordinate within the section
+ @param z the z coordinate within the section
+ @return the global block state id
+*/
+int32_t getSectionState(const struct section* s, int x, int y, int z);
+
+/*!
+ @brief Sets the block at the given position within the section, growing the palette if necessary
+ @param s the section
+ @param x the x coordinate within the section
+ @param y the y coordinate within the section
+ @param z the z coordinate within the section
+ @param state the global block state id
+ @param version pointer to a struct that defines all game version dependant constants
+ @return 0 on success, -1 for error
+*/
+int setSectionState(struct section* s, int x, int y, int z, int32_t state, const struct gameVersion* version);
+
+/*!
+ @brief Gets the global block state id at the given position
+ @param current the gamestate
+ @param pos the block position
+ @return the global block state id, or -1 if the chunk isn't loaded. Waits for the chunk if it's still being decoded
+*/
+int32_t getBlockState(struct gamestate* current, position pos);
+
 /*!
  @brief handles the SYNCHRONIZE_PLAYER_POSITION packet
 */
 int handleSynchronizePlayerPosition(packet* input, struct gamestate* output, int* offset);
 
 /*!
- @brief Creates a version struct
+ @brief Creates a version struct by parsing the pixlyzer json. This is slow, so createCachedVersionStruct should be preferred
 */
 struct gameVersion* createVersionStruct(const char* versionJSON, const char* biomesJSON, uint32_t protocol);
 
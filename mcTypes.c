@@ -43,7 +43,74 @@ static inline uint64_t swapULong(uint64_t l){
 //Gets the size of the nbt tag in buffer, assumes the nbt tag is of the given type
 static inline size_t tagSize(const byte* buff, byte type);
 
-size_t writeVarInt(byte* buff, int32_t value){
+/*!
+ @brief Gets the highest of the entries
+ @param entries the entries
+ @param count the number of entries
+ @return the highest entry, or 0 if there are none
+*/
+static uint32_t highestEntry(const uint32_t* entries, size_t count);
+
+#define UNPACK_LANES 4 //entries extracted per vector operation. The shift vectors in the kernels are written out for 4 lanes
+#define UNPACK_BLOCK 64 //longs byte swapped at once by readPalettedContainer
+#define MAX_KERNEL_BITS 16 //widths above this fit less than UNPACK_LANES entries in a long, so they share a generic kernel
+
+//A long broadcast to every lane, and the entries extracted from it. gcc maps these to whatever SIMD registers the target has
+typedef uint64_t unpackVector __attribute__((vector_size(UNPACK_LANES * sizeof(uint64_t))));
+typedef uint32_t unpackedVector __attribute__((vector_size(UNPACK_LANES * sizeof(uint32_t))));
+
+/*Unpack kernel note
+Every width gets it's own kernel, so that the entries per long, the shifts and the mask are all compile time constants.
+Each long is broadcast into a vector and shifted by UNPACK_LANES different amounts at once. Entries that don't fill a whole vector, and the entries of the last partially used long, are extracted one by one
+*/
+#define defineUnpackKernel(BITS) \
+    static void unpack##BITS(const uint64_t* longs, uint32_t* out, size_t count){ \
+        enum{perLong = 64 / BITS, vectors = perLong / UNPACK_LANES}; \
+        const uint64_t mask = (1ULL << BITS) - 1; \
+        size_t full = count / perLong; \
+        for(size_t l = 0; l < full; l++, out += perLong){ \
+            unpackVector word = {}; \
+            word += longs[l]; \
+            unpackVector shift = {0, BITS, 2 * BITS, 3 * BITS}; \
+            _Pragma("GCC unroll 16") \
+            for(int v = 0; v < vectors; v++){ \
+                unpackedVector entries = __builtin_convertvector((word >> shift) & mask, unpackedVector); \
+                memcpy(out + v * UNPACK_LANES, &entries, sizeof(unpackedVector)); \
+                shift += UNPACK_LANES * BITS; \
+            } \
+            for(int i = vectors * UNPACK_LANES; i < perLong; i++){ \
+                out[i] = (uint32_t)((longs[l] >> (i * BITS)) & mask); \
+            } \
+        } \
+        for(size_t i = 0; i < count - full * perLong; i++){ \
+            out[i] = (uint32_t)((longs[full] >> (i * BITS)) & mask); \
+        } \
+    }
+
+defineUnpackKernel(1)
+defineUnpackKernel(2)
+defineUnpackKernel(3)
+defineUnpackKernel(4)
+defineUnpackKernel(5)
+defineUnpackKernel(6)
+defineUnpackKernel(7)
+defineUnpackKernel(8)
+defineUnpackKernel(9)
+defineUnpackKernel(10)
+defineUnpackKernel(11)
+defineUnpackKernel(12)
+defineUnpackKernel(13)
+defineUnpackKernel(14)
+defineUnpackKernel(15)
+defineUnpackKernel(16)
+
+static void (*const unpackKernels[MAX_KERNEL_BITS + 1])(const uint64_t*, uint32_t*, size_t) = {
+    NULL, unpack1, unpack2, unpack3, unpack4, unpack5, unpack6, unpack7, unpack8,
+    unpack9, unpack10, unpack11, unpack12, unpack13, unpack14, unpack15, unpack16
+};
+
+size_t writeVarInt(byte* buff, int32_t signedValue){
+    uint32_t value = (uint32_t)signedValue; //negative values take all 5 bytes instead of shifting forever
     short i = 0;
     while(true){
         if((value & ~SEGMENT_BITS) == 0){
@@ -279,17 +346,44 @@ static inline size_t tagSize(const byte* buff, byte type){
     return res;
 }
 
-slot readSlot(const byte* buff, int* index){
+int readSlot(const byte* buff, int* index, size_t limit, slot* out){
     getIndex(index)
+    const int start = *index;
     slot result = {};
     result.present = readBool(buff, index);
     if(result.present){
         result.id = readVarInt(buff, index);
         result.count = readByte(buff, index);
-        size_t sz = nbtSize(buff + *index, false);
-        result.NBT = nbt_parse(buff + *index, sz);
-        *index += sz;
+        if((size_t)(*index - start) > limit){
+            errno = EPROTO;
+            *out = (slot){};
+            return -1;
+        }
+        //items without nbt carry a lone TAG_END
+        if(readNBT(buff, index, limit - (*index - start), &result.NBT) != 0){
+            *out = (slot){};
+            return -1;
+        }
     }
+    *out = result;
+    return 0;
+}
+
+int readNBT(const byte* buff, int* index, size_t limit, nbt_node** out){
+    size_t consumed = 0;
+    *out = nbt_parse_prefix(buff + *index, limit, &consumed);
+    if(consumed == 0){ //even an absent tag takes up it's TAG_END
+        errno = errno == NBT_EMEM ? ENOMEM : EPROTO; //cNBT statuses aren't errno values
+        return -1;
+    }
+    *index += consumed;
+    return 0;
+}
+
+nbt_view readNBTView(const byte* buff, int* index, size_t limit){
+    size_t consumed = 0;
+    nbt_view result = nbt_view_open(buff + *index, limit, &consumed);
+    *index += consumed;
     return result;
 }
 
@@ -355,68 +449,105 @@ uint64_t readBigEndianULong(const byte* buff, int* index){
     return swapULong(littleEndian);
 }
 
-palettedContainer readPalettedContainer(const byte* buff, int* index, const int bitsLowest, const int bitsThreshold, const size_t globalPaletteSize){
-    palettedContainer result = {};
+void unpackEntries(const uint64_t* longs, uint8_t bits, uint32_t* out, size_t count){
+    if(bits <= MAX_KERNEL_BITS){
+        unpackKernels[bits](longs, out, count);
+        return;
+    }
+    uint32_t perLong = 64 / bits;
+    uint64_t mask = (1ULL << bits) - 1;
+    for(size_t i = 0; i < count; longs++){
+        uint64_t word = *longs;
+        for(uint32_t k = 0; k < perLong && i < count; k++, i++){
+            out[i] = (uint32_t)(word & mask);
+            word >>= bits;
+        }
+    }
+}
+
+bool varIntFits(const byte* buff, int index, size_t limit){
+    for(size_t i = 0; i < limit && i < MAX_VAR_INT; i++){
+        if((buff[index + i] & CONTINUE_BIT) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+int readPalettedContainer(const byte* buff, int* index, const int bitsLowest, const int bitsThreshold, const size_t globalPaletteSize, palettedContainer* container, size_t count, size_t limit){
+    const size_t end = (size_t)*index + limit;
+    requireBytes(*index, end, 1)
     byte bitsPerEntry = readByte(buff, index);
     if(bitsPerEntry == 0){
-        result.paletteSize = 1;
-        result.palette = malloc(sizeof(int32_t));
-        *result.palette = readVarInt(buff, index);
-        result.states = NULL;
-        (void)readVarInt(buff, index);
-        return result;
+        requireVarInt(buff, *index, end)
+        int32_t value = readVarInt(buff, index);
+        requireVarInt(buff, *index, end)
+        (void)readVarInt(buff, index); //the empty states array
+        if(value < 0 || (size_t)value >= globalPaletteSize){
+            errno = E2BIG;
+            return -1;
+        }
+        container->palette[0] = value;
+        container->paletteSize = 1;
+        memset(container->states, 0, count * sizeof(int32_t));
+        return 0;
+    }
+    size_t entryLimit = globalPaletteSize; //every entry has to be below this
+    if(bitsPerEntry >= bitsThreshold){ //global ids, packed with whatever width the server chose
+        if(bitsPerEntry > 32){
+            errno = EPROTO;
+            return -1;
+        }
+        container->paletteSize = 0;
     }
     else{
-        if(bitsPerEntry >= bitsThreshold){
-            bitsPerEntry = (byte)ceilf(log2f((float)globalPaletteSize));
-            result.palette = NULL;
-            result.paletteSize = 0;
+        if(bitsPerEntry < bitsLowest){
+            bitsPerEntry = bitsLowest;
         }
-        else{
-            if(bitsPerEntry < bitsLowest){
-                bitsPerEntry = bitsLowest;
-            }
-            result.paletteSize = readVarInt(buff, index);
-            result.palette = calloc(result.paletteSize, sizeof(uint32_t));
-            for(int n = 0; n < result.paletteSize; n++){
-                //this is a state index
-                uint32_t element = readVarInt(buff, index);
-                //sanity check 1
-                if(element > globalPaletteSize){
-                    errno = E2BIG; 
-                    free(result.palette);
-                    return nullPalettedContainer;
-                }
-                result.palette[n] = element;
-            }
+        requireVarInt(buff, *index, end)
+        int32_t paletteSize = readVarInt(buff, index);
+        if(paletteSize < 1 || paletteSize > (1 << bitsPerEntry)){
+            errno = EPROTO;
+            return -1;
         }
-        //and now we need to get the states
-        const uint16_t numPerLong = (uint16_t)(64/bitsPerEntry); //number of elements of the array in a single long
-        uint16_t arrIndex = 0; //the current MAIN array index
-        const int32_t numLongs = readVarInt(buff, index); //the number of longs the MAIN array has been split into
-        const size_t statesSize = (size_t)ceilf((float)numPerLong * (float)numLongs);
-        result.states = calloc(statesSize, sizeof(uint32_t)); //the states
-        for(int l = 0; l < numLongs; l++){//foreach Long
-            uint64_t ourLong = readBigEndianULong(buff, index);
-            for(uint8_t b = 0; b < numPerLong; b++){ //foreach element in long
-                if(arrIndex >= statesSize){
-                    break;
-                }
-                uint16_t bits = b * bitsPerEntry;
-                uint32_t state = (uint32_t)((createLongMask(bits, bitsPerEntry) & ourLong) >> bits);
-                //sanity check 2
-                if((result.palette != NULL && state > result.paletteSize) || state > globalPaletteSize){
-                    errno = E2BIG;
-                    free(result.palette);
-                    free(result.states);
-                    return nullPalettedContainer;
-                }
-                result.states[arrIndex] = state;
-                arrIndex++;
+        for(int32_t n = 0; n < paletteSize; n++){
+            requireVarInt(buff, *index, end)
+            int32_t element = readVarInt(buff, index);
+            if(element < 0 || (size_t)element >= globalPaletteSize){
+                errno = E2BIG;
+                return -1;
             }
+            container->palette[n] = element;
         }
+        container->paletteSize = paletteSize;
+        entryLimit = paletteSize;
     }
-    return result;
+    uint32_t perLong = 64 / bitsPerEntry;
+    requireVarInt(buff, *index, end)
+    int32_t numLongs = readVarInt(buff, index);
+    if(numLongs < 0 || (size_t)numLongs != (count + perLong - 1) / perLong){
+        errno = EPROTO;
+        return -1;
+    }
+    requireBytes(*index, end, (size_t)numLongs * sizeof(uint64_t))
+    //the longs are swapped a block at a time, and every block holds a whole number of longs worth of entries
+    uint64_t longs[UNPACK_BLOCK];
+    uint32_t* states = (uint32_t*)container->states;
+    for(int32_t l = 0; l < numLongs; l += UNPACK_BLOCK){
+        int32_t n = numLongs - l < UNPACK_BLOCK ? numLongs - l : UNPACK_BLOCK;
+        for(int32_t i = 0; i < n; i++){
+            longs[i] = readBigEndianULong(buff, index);
+        }
+        size_t first = (size_t)l * perLong;
+        size_t entries = (size_t)n * perLong;
+        unpackEntries(longs, bitsPerEntry, states + first, entries < count - first ? entries : count - first);
+    }
+    //a single check over all of the entries instead of one per entry
+    if(highestEntry(states, count) >= entryLimit){
+        errno = E2BIG;
+        return -1;
+    }
+    return 0;
 }
 
 bitSet readBitSet(const byte* buff, int* index){
@@ -430,6 +561,14 @@ bitSet readBitSet(const byte* buff, int* index){
     return result;
 }
 
+static uint32_t highestEntry(const uint32_t* entries, size_t count){
+    uint32_t highest = 0;
+    for(size_t i = 0; i < count; i++){
+        highest = entries[i] > highest ? entries[i] : highest;
+    }
+    return highest;
+}
+
 bool cmpByteArray(byteArray* a, byteArray* b){
     if(a->len != b->len){
         return false;
@@ -43,6 +43,29 @@ typedef int64_t position;
 #define MAX_VAR_INT 5 //Maximum number of bytes a VarInt can take up
 #define MAX_VAR_LONG 10 //Maximum number of bytes a VarLong can take up
 
+//Checks if n more bytes fit between index and end, so that reading them doesn't go past the end of the buffer
+#define bytesFit(index, end, n) ((size_t)(index) <= (size_t)(end) && (size_t)(end) - (size_t)(index) >= (size_t)(n))
+
+//The number of bytes between index and end, 0 if index is already past end
+#define bytesLeft(index, end) ((size_t)(index) < (size_t)(end) ? (size_t)(end) - (size_t)(index) : 0)
+
+//Checks if a whole VarInt starting at index fits before end
+#define varIntFitsBefore(buff, index, end) (bytesFit(index, end, 1) && varIntFits(buff, index, (size_t)(end) - (size_t)(index)))
+
+//Makes the calling function return -1 with errno set to EPROTO unless n more bytes fit before end
+#define requireBytes(index, end, n) \
+    if(!bytesFit(index, end, n)){ \
+        errno = EPROTO; \
+        return -1; \
+    }
+
+//Makes the calling function return -1 with errno set to EPROTO unless a whole VarInt fits before end
+#define requireVarInt(buff, index, end) \
+    if(!varIntFitsBefore(buff, index, end)){ \
+        errno = EPROTO; \
+        return -1; \
+    }
+
 //Gets the X from position
 #define positionX(position) (position >> 38)
 
@@ -104,8 +127,6 @@ typedef struct bitSet{
     int64_t* data;
 } bitSet;
 
-#define nullPalettedContainer (palettedContainer){0, NULL, NULL}
-
 #define blockPaletteLowest 4
 #define biomePaletteLowest 1
 
@@ -304,13 +325,34 @@ double readBigEndianDouble(const byte* buff, int* index);
 */
 size_t nbtSize(const byte* buff, bool inCompound);
 
+/*!
+ @brief Parses a network NBT tag in a single pass, instead of measuring it with nbtSize and then parsing it
+ @param buff the buffer to read from
+ @param index the pointer to the index at which the tag starts, is incremented by the number of bytes the tag took up
+ @param limit the number of bytes left in buff at index, the tag may not go past them
+ @param out pointer to where the parsed tag should be stored, NULL if the tag is absent (a lone TAG_END)
+ @return 0 on success, -1 if the tag is malformed, in which case errno is set and index isn't changed, so the caller must not keep reading after it
+*/
+int readNBT(const byte* buff, int* index, size_t limit, nbt_node** out);
+
+/*!
+ @brief Validates a network NBT tag and returns a view of it, without copying or allocating anything
+ @param buff the buffer to read from, which must outlive the view
+ @param index the pointer to the index at which the tag starts, is incremented by the number of bytes the tag took up
+ @param limit the number of bytes left in buff at index, the tag may not go past them
+ @return the view, whose type is TAG_INVALID if the tag is absent (a lone TAG_END) or malformed. In the latter case index isn't changed
+*/
+nbt_view readNBTView(const byte* buff, int* index, size_t limit);
+
 /*!
  @brief Reads a slot type from the memory
  @param buff the buffer to read from
  @param index the pointer to the index at which the value should be read, is incremented by the number of bytes read. Can be NULL, at which point index=0
- @return the encoded slot
+ @param limit the number of bytes left in buff at index, the slot's NBT may not go past them
+ @param out pointer to where the slot should be stored
+ @return 0 on success, -1 if the slot's NBT is malformed, in which case out is left empty
 */
-slot readSlot(const byte* buff, int* index);
+int readSlot(const byte* buff, int* index, size_t limit, slot* out);
 
 /*!
  @brief Reads a float from the memory
@@ -337,15 +379,36 @@ float readBigEndianFloat(const byte* buff, int* index);
 int64_t readVarLong(const byte* buff, int* index);
 
 /*!
- @brief Reads a palettedContainer from buffer
+ @brief Reads a palettedContainer from buffer into storage provided by the caller
  @param buff the buffer to read from
- @param index the pointer to the index at which the value should be read, is incremented by the number of bytes read. Can be NULL, at which point index=0
+ @param index the pointer to the index at which the value should be read, is incremented by the number of bytes read
  @param bitsLowest the lowest acceptable size of elements in states
- @param bitsThreshold the threshold that determines whether bits per element in the states array should be determined dynamicly
+ @param bitsThreshold the size of elements at and above which the states hold global ids instead of palette indexes
  @param globalPaletteSize the size of the globalPallete the palette in this palettedContainer will point to
- @return palettedContainer or nullPalettedContainer on error
+ @param container the container to read into. It's palette must have room for 1 << (bitsThreshold - 1) entries and it's states for count entries. A paletteSize of 0 means the states hold global ids
+ @param count the number of entries in the container
+ @param limit the number of bytes left in buff at index, the container may not go past them
+ @return 0 on success, -1 for error
+*/
+int readPalettedContainer(const byte* buff, int* index, const int bitsLowest, const int bitsThreshold, const size_t globalPaletteSize, palettedContainer* container, size_t count, size_t limit);
+
+/*!
+ @brief Checks if a whole VarInt fits in the buffer, so that it can be read without reading past the end
+ @param buff the buffer the VarInt is in
+ @param index the index at which the VarInt starts
+ @param limit the number of bytes left in buff at index
+ @return true if the VarInt ends within limit bytes
+*/
+bool varIntFits(const byte* buff, int index, size_t limit);
+
+/*!
+ @brief Unpacks entries packed into longs the way the protocol packs them, lowest bits first and never across two longs
+ @param longs the longs, in native byte order
+ @param bits the number of bits per entry, between 1 and 32
+ @param out array of at least count entries the entries get written to
+ @param count the number of entries to unpack
 */
-palettedContainer readPalettedContainer(const byte* buff, int* index, const int bitsLowest, const int bitsThreshold, const size_t globalPaletteSize);
+void unpackEntries(const uint64_t* longs, uint8_t bits, uint32_t* out, size_t count);
 
 /*!
  @brief reads a java like bitset from the buffer at index
@@ -1,15 +1,19 @@
 #include "networkingMc.h"
 #include "packetDefinitions.h"
+#include "recordingMc.h"
 #include "cJSON/cJSON.h"
 
 #include <stdbool.h>
 #include <errno.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #if defined(__unix__)
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #elif defined(_WIN32)
 #include <conio.h>
@@ -18,37 +22,226 @@
 #define bzero(b,len) (memset((b), '\0', (len)), (void) 0) 
 #include <bcrypt.h> 
 #define getentropy(ptr, len) BCryptGenRandom(NULL, ptr, len, BCRYPT_USE_SYSTEM_PREFERRED_RNG)  
+struct iovec{
+    void* iov_base;
+    size_t iov_len;
+};
+//no scatter-gather here, so we write the first part and let writeParts handle the rest as a partial write
+#define writev(fd, parts, count) write(fd, (parts)->iov_base, (parts)->iov_len)
+#define SHUT_RD SD_RECEIVE
 #endif
 
+#define FRAME_HEADER (MAX_VAR_INT * 3) //room for the packet length, data length and packet id VarInts
+
+#define PIPELINE_DEPTH 1024 //number of packets the pipeline ring can hold, has to be a power of 2
+
+//A framed packet waiting in the pipeline ring
+struct pipelineEntry{
+    packet p;
+    byte* buffer; //the pool buffer p.data points into
+};
+
+/*Pipeline note
+The I/O thread frames and decompresses packets and pushes them into a single-producer/single-consumer ring.
+The gamestate thread pops them in getPacket, so they are applied in order. Each side only ever advances it's own index.
+The mutex and condition variables are only touched when one side has to sleep on an empty or full ring.
+Uncompressed packets are copied out of the receive buffer into pool buffers, since the I/O thread keeps reading into it. Packets up to POOL_SLAB_SIZE come from the pool's slabs, so a ring backed up with small packets costs no allocation per packet
+*/
+struct pipeline{
+    struct pipelineEntry ring[PIPELINE_DEPTH];
+    _Atomic size_t head; //next entry to be popped, only advanced by the gamestate thread
+    _Atomic size_t tail; //next entry to be pushed, only advanced by the I/O thread
+    _Atomic bool running;
+    _Atomic bool finished; //set once the I/O thread won't push anything anymore
+    _Atomic bool consumerWaiting;
+    _Atomic bool producerWaiting;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    pthread_t thread;
+    int compression;
+    bool fastLane; //if true the I/O thread answers latency critical packets itself
+    byte* borrowed; //the buffer of the packet currently handed out by getPacket
+    _Atomic uint64_t packets;
+    _Atomic uint64_t producerStalls;
+    _Atomic uint64_t consumerStalls;
+    _Atomic size_t maxDepth;
+    _Atomic uint64_t fastLaneReplies;
+};
+
 #include <zlib.h>
 
 //Private functions
 
 /*!
- @brief Reads the socket
+ @brief Frames the next packet from the connection's receive buffer, reading the socket only if the buffer doesn't yet hold the whole packet
+ @param conn the connection to read from
+ @return the byteArray stored within the socket, or a NULL byteArray on error or EOF. The bytes point into the receive buffer and stay valid only until the next readSocket call
+*/
+static byteArray readSocket(struct connection* conn);
+
+/*!
+ @brief Makes sure that the receive buffer holds at least the given amount of unframed bytes, reading the socket in large blocks if it doesn't
+ @param in the receive buffer
+ @param socketFd the socket file descriptor
+ @param needed the number of unframed bytes required
+ @return 0 on success, -1 for error or EOF
+*/
+static int fillReceiveBuffer(struct receiveBuffer* in, int socketFd, size_t needed);
+
+/*!
+ @brief Writes the given parts to the socket, retrying on partial writes until everything is written or a non-blocking socket is full
  @param socketFd the socket file descriptor
- @return the byteArray stored within the socket, or a NULL byteArray on error or EOF
+ @param parts the parts to write, get modified in the process
+ @param count pointer to the number of parts, gets updated to the number of parts that still have bytes left
+ @return the number of bytes written, or -1 for error
+*/
+static ssize_t writeParts(int socketFd, struct iovec* parts, int* count);
+
+/*!
+ @brief Inserts the parts into the send buffer
+ @param out the send buffer
+ @param at the index in the send buffer to insert the parts at
+ @param parts the parts to insert
+ @param count the number of parts
+ @return 0 on success, -1 for error
+*/
+static int queueParts(struct sendBuffer* out, size_t at, const struct iovec* parts, int count);
+
+/*!
+ @brief Writes as much of the send buffer as may already leave and the socket accepts. The caller must hold the send lock
+ @param conn the connection whose send buffer should be written
+ @return the number of bytes written, or -1 for error
 */
-static byteArray readSocket(int socketFd);
+static ssize_t writeQueued(struct connection* conn);
 
 /*!
- @brief Parses the raw packet data into a nice struct
+ @brief Sends a fully framed packet, or appends it to the send buffer if the connection is corked or a non-blocking socket is full
+ @param conn the connection to send the frame over
+ @param parts the parts making up the frame, get modified in the process
+ @param count the number of parts
+ @param direct if true the frame is written right away, even if the connection is corked
+ @return the number of bytes written or queued, or -1 for error
+*/
+static ssize_t sendFrame(struct connection* conn, struct iovec* parts, int count, bool direct);
+
+/*!
+ @brief Compresses the packet and sends it with the frame header written in place in front of the compressed data
+ @param conn the connection to send the packet over
+ @param size the size of data
+ @param id the packet id already encoded as VarInt
+ @param idSize the size of id
+ @param data the values of fields of the packet, or NULL
+ @param direct if true the frame is written right away, even if the connection is corked
+ @return the number of bytes written or queued, or -1 for error
+*/
+static ssize_t sendCompressed(struct connection* conn, int size, const byte* id, size_t idSize, const byte* data, bool direct);
+
+/*!
+ @brief Frames and sends the packet. The caller must hold the send lock
+ @param direct if true the frame is written right away, even if the connection is corked
+ @return the number of bytes written or queued, or -1 for error
+*/
+static ssize_t framePacket(struct connection* conn, int size, int packetId, const byte* data, int compression, bool direct);
+
+/*!
+ @brief Answers KEEP_ALIVE, PING_PLAY and SYNCHRONIZE_PLAYER_POSITION straight from the I/O thread
+ @param conn the connection the packet was framed from
+ @param p the freshly framed packet
+ @param compression the established compression level
+ @return true if the packet has been fully handled and shouldn't reach the gamestate thread
+*/
+static bool answerFastLane(struct connection* conn, const packet* p, int compression);
+
+/*!
+ @brief The I/O thread of the pipeline. Frames and decompresses packets until the pipeline is stopped or the socket errors out
+ @param arg the connection
+ @return NULL
+*/
+static void* pipelineWorker(void* arg);
+
+/*!
+ @brief Pushes the entry to the pipeline ring, waiting if the ring is full
+ @param pipe the pipeline
+ @param entry the entry to push
+ @return false if the pipeline was stopped while waiting
+*/
+static bool pipelinePush(struct pipeline* pipe, const struct pipelineEntry* entry);
+
+/*!
+ @brief Pops the next packet from the pipeline ring, waiting if the ring is empty
+ @param pipe the pipeline
+ @return the packet, borrowed from the pipeline, or a nullPacket once the I/O thread has stopped
+*/
+static packet pipelinePop(struct pipeline* pipe);
+
+/*!
+ @brief Parses the raw packet data into a nice struct, without copying the payload
+ @param conn the connection the packet was framed from, which owns the buffer decompressed packets are written to
  @param dataArray pointer to the packet data alongside it's size
  @param compression the established compression level
- @return the packet struct or a nullPacket to indicate error
+ @return the packet struct, borrowing it's data from conn, or a nullPacket to indicate error
 */
-static packet parsePacket(const byteArray* dataArray, int compression);
+static packet parsePacket(struct connection* conn, const byteArray* dataArray, int compression);
 
 /*Socket reading note
 The process of getting a valid packet goes like this:
-readSocket -tries reading-> getPacketBytes -tries reading until timeout-> parsePacket -parses the packet-> getPacket()
+readSocket -frames the packet-> fillReceiveBuffer -reads big blocks from the socket if necessary-> parsePacket -parses the packet-> getPacket()
+A single read can pull many packets into the receive buffer, and those are then framed without touching the socket again
 */
 
-ssize_t requestPacket(int socketFd, int packetType, int compression){
-    return sendPacket(socketFd, 0, packetType, NULL, compression);
+struct connection* initConnection(int socketFd){
+    struct connection* conn = calloc(1, sizeof(struct connection));
+    if(conn == NULL){
+        return NULL;
+    }
+    conn->socketFd = socketFd;
+    pthread_mutex_init(&conn->sendLock, NULL);
+    conn->in.capacity = RECEIVE_BLOCK;
+    conn->in.bytes = malloc(conn->in.capacity);
+    conn->pool = initPool();
+    //the inflate state is set up once and then only reset for each packet
+    if(conn->in.bytes == NULL || conn->pool == NULL || inflateInit(&conn->inflater) != Z_OK){
+        free(conn->in.bytes);
+        freePool(conn->pool);
+        free(conn);
+        return NULL;
+    }
+    //same goes for the deflate state, whose window is kept small since outbound packets rarely are
+    if(deflateInit2(&conn->deflater, DEFAULT_COMPRESSION_LEVEL, Z_DEFLATED, DEFLATE_WINDOW_BITS, DEFLATE_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK){
+        inflateEnd(&conn->inflater);
+        free(conn->in.bytes);
+        freePool(conn->pool);
+        free(conn);
+        return NULL;
+    }
+    return conn;
+}
+
+void freeConnection(struct connection* conn){
+    if(conn != NULL){
+        stopPipeline(conn);
+        stopRecording(conn);
+        free(conn->in.bytes);
+        inflateEnd(&conn->inflater);
+        deflateEnd(&conn->deflater);
+        poolRelease(conn->pool, conn->inflated);
+        freePool(conn->pool);
+        free(conn->out.bytes);
+        for(int i = 0; i < conn->bundled; i++){
+            free(conn->bundle[i].data);
+        }
+        free(conn->bundle);
+        pthread_mutex_destroy(&conn->sendLock);
+        free(conn);
+    }
+}
+
+ssize_t requestPacket(struct connection* conn, int packetType, int compression){
+    return sendPacket(conn, 0, packetType, NULL, compression);
 }
 
-ssize_t handshake(int socketFd, const char* host, int32_t protocol, uint16_t port, int32_t nextState){
+ssize_t handshake(struct connection* conn, const char* host, int32_t protocol, uint16_t port, int32_t nextState){
     size_t hostLen = strlen(host);
     size_t handshakeLen = sizeof(int16_t) + (MAX_VAR_INT * 3) + hostLen;
     byte* handshake = calloc(handshakeLen, sizeof(byte));
@@ -57,102 +250,346 @@ ssize_t handshake(int socketFd, const char* host, int32_t protocol, uint16_t por
     size_t off3 = writeBigEndianUShort(handshake + off1 + off2, port);
     size_t off4 = writeVarInt(handshake + off1 + off2 + off3, nextState);
     handshakeLen = off1 + off2 + off3 + off4;
-    ssize_t res = sendPacket(socketFd, handshakeLen, HANDSHAKE, handshake, NO_COMPRESSION);
+    ssize_t res = sendPacket(conn, handshakeLen, HANDSHAKE, handshake, NO_COMPRESSION);
     free(handshake);
     return res;
 }
 
-ssize_t sendPacket(int socketFd, int size, int packetId, const byte* data, int compression){
+ssize_t sendPacket(struct connection* conn, int size, int packetId, const byte* data, int compression){
+    pthread_mutex_lock(&conn->sendLock);
+    ssize_t res = framePacket(conn, size, packetId, data, compression, false);
+    pthread_mutex_unlock(&conn->sendLock);
+    return res;
+}
+
+static ssize_t framePacket(struct connection* conn, int size, int packetId, const byte* data, int compression, bool direct){
+    if(data == NULL){
+        size = 0;
+    }
+    byte id[MAX_VAR_INT] = {};
+    size_t idSize = writeVarInt(id, packetId);
+    if(compression > NO_COMPRESSION && size + idSize > compression){
+        return sendCompressed(conn, size, id, idSize, data, direct);
+    }
+    //the header is built on the stack and sent alongside the data in a single syscall
+    byte header[FRAME_HEADER] = {};
+    size_t headerSize = 0;
     if(compression <= NO_COMPRESSION){ //packet type without compression
+        headerSize = writeVarInt(header, size + idSize);
+    }
+    else{ //below the threshold the data length is 0 and the data isn't compressed
+        headerSize = writeVarInt(header, size + idSize + 1);
+        header[headerSize] = 0;
+        headerSize++;
+    }
+    memcpy(header + headerSize, id, idSize);
+    headerSize += idSize;
+    struct iovec parts[2] = {{header, headerSize}, {(void*)data, size}};
+    return sendFrame(conn, parts, data != NULL ? 2 : 1, direct);
+}
+
+static ssize_t sendCompressed(struct connection* conn, int size, const byte* id, size_t idSize, const byte* data, bool direct){
+    z_stream* deflater = &conn->deflater;
+    uLong dataLength = idSize + size;
+    uLong bound = deflateBound(deflater, dataLength);
+    byte* frame = poolAcquire(conn->pool, FRAME_HEADER + bound);
+    if(frame == NULL){
+        return -1;
+    }
+    deflateReset(deflater);
+    //we leave room in front of the compressed data for the header
+    deflater->next_out = frame + FRAME_HEADER;
+    deflater->avail_out = bound;
+    //the id and the data are fed separately, so they never need to be copied together
+    deflater->next_in = (byte*)id;
+    deflater->avail_in = idSize;
+    int status = deflate(deflater, Z_NO_FLUSH);
+    if(status == Z_OK){
+        deflater->next_in = (byte*)data;
+        deflater->avail_in = data != NULL ? size : 0;
+        status = deflate(deflater, Z_FINISH);
+    }
+    ssize_t res = -1;
+    if(status == Z_STREAM_END){
+        uLong destLen = deflater->total_out;
+        byte l[MAX_VAR_INT] = {};
+        size_t sizeL = writeVarInt(l, dataLength);
         byte p[MAX_VAR_INT] = {};
-        size_t pSize = writeVarInt(p, packetId);
-        byte s[MAX_VAR_INT] = {};
-        size_t sSize = writeVarInt(s, size + pSize);
-        if(write(socketFd, s, sSize) == -1 || write(socketFd, p, pSize) == -1){
+        size_t sizeP = writeVarInt(p, destLen + sizeL);
+        byte* start = frame + FRAME_HEADER - sizeL - sizeP;
+        memcpy(start, p, sizeP);
+        memcpy(start + sizeP, l, sizeL);
+        struct iovec part = {start, sizeP + sizeL + destLen};
+        res = sendFrame(conn, &part, 1, direct);
+    }
+    poolRelease(conn->pool, frame);
+    return res;
+}
+
+int setCompressionLevel(struct connection* conn, int level){
+    pthread_mutex_lock(&conn->sendLock);
+    deflateReset(&conn->deflater);
+    int res = deflateParams(&conn->deflater, level, Z_DEFAULT_STRATEGY);
+    pthread_mutex_unlock(&conn->sendLock);
+    if(res != Z_OK){
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static ssize_t writeParts(int socketFd, struct iovec* parts, int* count){
+    ssize_t written = 0;
+    struct iovec* first = parts;
+    while(*count > 0){
+        ssize_t w = writev(socketFd, first, *count);
+        if(w < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno == EAGAIN || errno == EWOULDBLOCK){ //the rest has to wait until the socket is writable again
+                break;
+            }
             return -1;
         }
-        if(data != NULL){
-            return write(socketFd, data, size);
+        written += w;
+        //skip everything that has been fully written
+        while(*count > 0 && (size_t)w >= first->iov_len){
+            w -= first->iov_len;
+            first++;
+            (*count)--;
+        }
+        if(*count > 0){
+            first->iov_base = (byte*)first->iov_base + w;
+            first->iov_len -= w;
         }
-        return sSize + 1;
     }
-    else{
-        byte* dataToCompress = calloc(MAX_VAR_INT + size, sizeof(byte));
-        size_t offset = writeVarInt(dataToCompress, packetId);
-        memcpy(dataToCompress + offset, data, size);
-        //ok so now we can compress
-        int dataLength = offset + size;
-        uLongf destLen = dataLength;
-        if(size + offset > compression){
-            byte* compressed = calloc(destLen, sizeof(byte));
-            if(compress(compressed, &destLen, dataToCompress, destLen) != Z_OK){
+    //move the parts that are left to the front, so that the caller can find them
+    memmove(parts, first, *count * sizeof(struct iovec));
+    return written;
+}
+
+static int queueParts(struct sendBuffer* out, size_t at, const struct iovec* parts, int count){
+    size_t total = 0;
+    for(int i = 0; i < count; i++){
+        total += parts[i].iov_len;
+    }
+    if(out->capacity - out->len < total){
+        size_t newCapacity = out->capacity * 2;
+        if(newCapacity < out->len + total){
+            newCapacity = out->len + total;
+        }
+        byte* newBytes = realloc(out->bytes, newCapacity);
+        if(newBytes == NULL){
+            return -1;
+        }
+        out->bytes = newBytes;
+        out->capacity = newCapacity;
+    }
+    memmove(out->bytes + at + total, out->bytes + at, out->len - at);
+    for(int i = 0; i < count; i++){
+        memcpy(out->bytes + at, parts[i].iov_base, parts[i].iov_len);
+        at += parts[i].iov_len;
+    }
+    out->len += total;
+    return 0;
+}
+
+static ssize_t writeQueued(struct connection* conn){
+    struct sendBuffer* out = &conn->out;
+    struct iovec ready = {out->bytes, out->ready};
+    int count = 1;
+    ssize_t w = writeParts(conn->socketFd, &ready, &count);
+    if(w > 0){
+        memmove(out->bytes, out->bytes + w, out->len - w);
+        out->len -= w;
+        out->ready -= w;
+    }
+    return w;
+}
+
+static ssize_t sendFrame(struct connection* conn, struct iovec* parts, int count, bool direct){
+    struct sendBuffer* out = &conn->out;
+    size_t total = 0;
+    for(int i = 0; i < count; i++){
+        total += parts[i].iov_len;
+    }
+    if(out->corked && !direct){
+        if(queueParts(out, out->len, parts, count) != 0){
+            return -1;
+        }
+        return total;
+    }
+    if(out->ready > 0){
+        //earlier bytes are still waiting for the socket, so this frame has to go right after them
+        if(queueParts(out, out->ready, parts, count) != 0){
+            return -1;
+        }
+        out->ready += total;
+        if(writeQueued(conn) < 0){
+            return -1;
+        }
+        return total;
+    }
+    if(writeParts(conn->socketFd, parts, &count) < 0){
+        return -1;
+    }
+    if(count > 0){ //the socket is full, the rest leaves before anything else does
+        size_t left = 0;
+        for(int i = 0; i < count; i++){
+            left += parts[i].iov_len;
+        }
+        if(queueParts(out, 0, parts, count) != 0){
+            return -1;
+        }
+        out->ready += left;
+    }
+    return total;
+}
+
+void corkConnection(struct connection* conn){
+    pthread_mutex_lock(&conn->sendLock);
+    conn->out.corked = true;
+    conn->out.flushing = false; //a new batch starts, whatever is left of the previous one still gets drained
+    pthread_mutex_unlock(&conn->sendLock);
+}
+
+ssize_t flushConnection(struct connection* conn){
+    pthread_mutex_lock(&conn->sendLock);
+    struct sendBuffer* out = &conn->out;
+    out->ready = out->len;
+    ssize_t len = 0;
+    if(out->ready > 0){
+        len = writeQueued(conn);
+    }
+    //packets sent before the socket took the whole batch are collected behind it
+    out->flushing = len >= 0 && out->ready > 0;
+    out->corked = out->flushing;
+    pthread_mutex_unlock(&conn->sendLock);
+    return len;
+}
+
+ssize_t drainConnection(struct connection* conn){
+    pthread_mutex_lock(&conn->sendLock);
+    struct sendBuffer* out = &conn->out;
+    ssize_t len = 0;
+    if(out->ready > 0){
+        len = writeQueued(conn);
+    }
+    if(len >= 0 && out->ready == 0 && out->flushing){
+        //the batch is out, so whatever was collected behind it may follow
+        out->flushing = false;
+        out->corked = false;
+        out->ready = out->len;
+        if(out->ready > 0){
+            ssize_t more = writeQueued(conn);
+            len = more < 0 ? -1 : len + more;
+        }
+    }
+    pthread_mutex_unlock(&conn->sendLock);
+    return len;
+}
+
+size_t queuedBytes(struct connection* conn){
+    pthread_mutex_lock(&conn->sendLock);
+    size_t ready = conn->out.ready;
+    pthread_mutex_unlock(&conn->sendLock);
+    return ready;
+}
+
+static int fillReceiveBuffer(struct receiveBuffer* in, int socketFd, size_t needed){
+    if(in->end - in->start >= needed){
+        return 0;
+    }
+    if(in->capacity - in->start < needed){
+        //move the unframed bytes to the front of the buffer
+        memmove(in->bytes, in->bytes + in->start, in->end - in->start);
+        in->end -= in->start;
+        in->start = 0;
+        if(in->capacity < needed){
+            size_t newCapacity = in->capacity * 2;
+            if(newCapacity < needed){
+                newCapacity = needed;
+            }
+            byte* newBytes = realloc(in->bytes, newCapacity);
+            if(newBytes == NULL){
                 return -1;
             }
-            free(dataToCompress);
-            dataToCompress = compressed;
+            in->bytes = newBytes;
+            in->capacity = newCapacity;
         }
-        else{
-            dataLength = 0;
+    }
+    while(in->end - in->start < needed){
+        //read as much as the socket has, not just what we need
+        ssize_t r = read(socketFd, in->bytes + in->end, in->capacity - in->end);
+        if(r == 0){ //EOF, which mustn't be mistaken for a non-blocking socket running dry
+            errno = ECONNRESET;
+            return -1;
         }
-        byte* packet = calloc(destLen + (MAX_VAR_INT * 2), sizeof(byte));
-        byte l[MAX_VAR_INT] = {};
-        size_t sizeL = writeVarInt(l, dataLength);
-        size_t sizeP = writeVarInt(packet, destLen + sizeL);
-        memcpy(packet + sizeP, l, sizeL);
-        memcpy(packet + sizeP + sizeL, dataToCompress, destLen);
-        free(dataToCompress);
-        ssize_t res = write(socketFd, packet, destLen + sizeP + sizeL);
-        free(packet);
-        return res;
+        if(r < 0){
+            return -1;
+        }
+        in->end += r;
     }
+    return 0;
 }
 
-static byteArray readSocket(int socketFd){
-    byteArray result = nullByteArray;
+static byteArray readSocket(struct connection* conn){
+    struct receiveBuffer* in = &conn->in;
+    if(in->start == in->end){ //everything has been framed, so we can start from the front
+        in->start = 0;
+        in->end = 0;
+    }
     int size = 0;
     int position = 0;
+    size_t header = 0; //the size of the length VarInt
     while(true){
-        byte curByte = 0;
-        if(read(socketFd, &curByte, 1) < 1){
-            return result;
+        if(fillReceiveBuffer(in, conn->socketFd, header + 1) != 0){
+            return nullByteArray;
         }
+        byte curByte = in->bytes[in->start + header];
+        header++;
         size |= (curByte & SEGMENT_BITS) << position;
         if((curByte & CONTINUE_BIT) == 0) break;
         position += 7;
-    }
-    result.len = size;
-    byte* input = calloc(size, sizeof(byte));
-    int nRead = 0;
-    //While we have't read the entire packet
-    while(nRead < size){
-        //Read the rest of the packet
-        int r = read(socketFd, input + nRead, size - nRead);
-        if(r < 1){
-            free(input);
-            return result;
+        if(header >= MAX_VAR_INT){
+            errno = EOVERFLOW;
+            return nullByteArray;
         }
-        nRead += r;
     }
-    result.bytes = input;
+    if(size < 0 || fillReceiveBuffer(in, conn->socketFd, header + size) != 0){
+        return nullByteArray;
+    }
+    byteArray result = {in->bytes + in->start + header, size};
+    in->start += header + size;
     return result;
 }
 
-static packet parsePacket(const byteArray* dataArray, int compression){
+static packet parsePacket(struct connection* conn, const byteArray* dataArray, int compression){
     packet result = nullPacket;
     int index = 0;
-    bool alloc = false;
     byte* data = dataArray->bytes;
     if(compression > NO_COMPRESSION){
         uLongf dataLength = (uLongf)readVarInt(data, &index);
         int compressedLen = dataArray->len - index;
         if(dataLength != 0){
-            byte* uncompressed = calloc(dataLength, sizeof(byte));
-            alloc = true;
-            if(uncompress(uncompressed, &dataLength, data + index, compressedLen) != Z_OK){
-                free(uncompressed);
+            //decompress into a pooled buffer instead of a fresh allocation
+            byte* inflated = poolAcquire(conn->pool, dataLength);
+            if(inflated == NULL){
+                return nullPacket;
+            }
+            z_stream* inflater = &conn->inflater;
+            inflateReset(inflater);
+            inflater->next_in = data + index;
+            inflater->avail_in = compressedLen;
+            inflater->next_out = inflated;
+            inflater->avail_out = dataLength;
+            if(inflate(inflater, Z_FINISH) != Z_STREAM_END || inflater->total_out != dataLength){
+                poolRelease(conn->pool, inflated);
                 return nullPacket;
-            } 
-            data = uncompressed;
+            }
+            conn->inflated = inflated;
+            data = inflated;
             index = 0;
             result.size = dataLength;
         }
@@ -163,31 +600,28 @@ static packet parsePacket(const byteArray* dataArray, int compression){
     else{
         result.size = dataArray->len;
     }
+    int idStart = index;
     result.packetId = readVarInt(data, &index);
-    result.size -= 1; //packetId will should take up a byte at most
-    result.data = calloc(result.size, sizeof(byte));
-    memcpy(result.data, data + index, result.size);
-    if(alloc){ //we discard the const since actually we no longer have a const value
-        free((byte*)data);
-    }
+    result.size -= index - idStart;
+    result.data = data + index;
     return result;
 }
 
-int64_t pingPong(int socketFd){
+int64_t pingPong(struct connection* conn){
     //ping
     int64_t now = (int64_t)clock();
     byte timeBuff[sizeof(int64_t)] = {};
     memcpy(timeBuff, &now, sizeof(int64_t));
-    if(sendPacket(socketFd, sizeof(int64_t), PING_REQUEST, timeBuff, NO_COMPRESSION) < 1){
+    if(sendPacket(conn, sizeof(int64_t), PING_REQUEST, timeBuff, NO_COMPRESSION) < 1){
         return -1;
     }
     //pong
-    packet pong = getPacket(socketFd, NO_COMPRESSION);
+    packet pong = getPacket(conn, NO_COMPRESSION);
     if(pong.data == NULL || pong.packetId != PING_RESPONSE){
         return -3;
     }
     int64_t diff = *((int64_t*)pong.data) - now;
-    free(pong.data);
+    releasePacket(conn, &pong);
     return diff;
 }
 
@@ -202,7 +636,7 @@ int connectSocket(int socketFd, const char* host, int port){
     return connect(socketFd, (struct sockaddr*)&serverAddress, sizeof(serverAddress));
 }
 
-ssize_t startLogin(int socketFd, const char* name, const UUID_t* player){
+ssize_t startLogin(struct connection* conn, const char* name, const UUID_t* player){
     byte data[16 + MAX_VAR_INT + 1 + sizeof(UUID_t)] = {};
     size_t offset = writeString(data, name, strlen(name));
     size_t packetLen = offset + 1;
@@ -215,23 +649,293 @@ ssize_t startLogin(int socketFd, const char* name, const UUID_t* player){
         memcpy(data + offset, player, sizeof(UUID_t));
         packetLen += sizeof(UUID_t);
     }
-    return sendPacket(socketFd, packetLen, LOGIN_START, data, NO_COMPRESSION);
+    return sendPacket(conn, packetLen, LOGIN_START, data, NO_COMPRESSION);
+}
+
+packet getPacket(struct connection* conn, int compression){
+    packet result = nullPacket;
+    if(conn->pipeline != NULL){
+        poolRelease(conn->pool, conn->pipeline->borrowed);
+        conn->pipeline->borrowed = NULL;
+        result = pipelinePop(conn->pipeline);
+        compression = conn->pipeline->compression;
+    }
+    else{
+        //the previous packet is implicitly released
+        poolRelease(conn->pool, conn->inflated);
+        conn->inflated = NULL;
+        byteArray newPacket = readSocket(conn);
+        if(newPacket.bytes == NULL){
+            return nullPacket;
+        }
+        result = parsePacket(conn, &newPacket, compression);
+        if(conn->recording != NULL && result.data != NULL){
+            recordPacket(conn->recording, &result, compression);
+        }
+    }
+    return result;
+}
+
+void releasePacket(struct connection* conn, packet* borrowed){
+    borrowed->data = NULL;
+    if(conn->pipeline != NULL){ //the receive buffer belongs to the I/O thread
+        poolRelease(conn->pool, conn->pipeline->borrowed);
+        conn->pipeline->borrowed = NULL;
+        return;
+    }
+    poolRelease(conn->pool, conn->inflated);
+    conn->inflated = NULL;
+    if(conn->in.start == conn->in.end){
+        conn->in.start = 0;
+        conn->in.end = 0;
+    }
 }
 
-packet getPacket(int socketFd, int compression){
-    byteArray newPacket = readSocket(socketFd);
-    if(newPacket.bytes == NULL){
+packet keepPacket(const packet* borrowed){
+    packet kept = *borrowed;
+    kept.data = malloc(borrowed->size);
+    if(kept.data == NULL){
         return nullPacket;
     }
-    packet response = parsePacket(&newPacket, compression);
-    free(newPacket.bytes);
-    return response;
+    memcpy(kept.data, borrowed->data, borrowed->size);
+    return kept;
+}
+
+int startPipeline(struct connection* conn, int compression, packet* current, bool fastLane){
+    if(conn->pipeline != NULL){
+        errno = EALREADY;
+        return -1;
+    }
+    struct pipeline* pipe = calloc(1, sizeof(struct pipeline));
+    if(pipe == NULL){
+        return -1;
+    }
+    pipe->compression = compression;
+    pipe->fastLane = fastLane;
+    atomic_store(&pipe->running, true);
+    if(current != NULL && current->data != NULL){
+        //the I/O thread will reuse the receive buffer, so the current packet has to move out of it
+        pipe->borrowed = poolAcquire(conn->pool, current->size);
+        if(pipe->borrowed == NULL){
+            free(pipe);
+            return -1;
+        }
+        memcpy(pipe->borrowed, current->data, current->size);
+        current->data = pipe->borrowed;
+    }
+    poolRelease(conn->pool, conn->inflated);
+    conn->inflated = NULL;
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->notEmpty, NULL);
+    pthread_cond_init(&pipe->notFull, NULL);
+    conn->pipeline = pipe;
+    int res = pthread_create(&pipe->thread, NULL, pipelineWorker, conn);
+    if(res != 0){
+        //the connection takes the current packet's buffer back, just as if it was never pipelined
+        conn->pipeline = NULL;
+        conn->inflated = pipe->borrowed;
+        pthread_mutex_destroy(&pipe->lock);
+        pthread_cond_destroy(&pipe->notEmpty);
+        pthread_cond_destroy(&pipe->notFull);
+        free(pipe);
+        errno = res;
+        return -1;
+    }
+    return 0;
+}
+
+int stopPipeline(struct connection* conn){
+    struct pipeline* pipe = conn->pipeline;
+    if(pipe == NULL){
+        return 0;
+    }
+    atomic_store(&pipe->running, false);
+    //wake the I/O thread up, whether it's blocked on the socket or on a full ring
+    shutdown(conn->socketFd, SHUT_RD);
+    pthread_mutex_lock(&pipe->lock);
+    pthread_cond_broadcast(&pipe->notFull);
+    pthread_mutex_unlock(&pipe->lock);
+    int res = pthread_join(pipe->thread, NULL);
+    //release everything that hasn't been applied
+    for(size_t i = atomic_load(&pipe->head); i != atomic_load(&pipe->tail); i++){
+        poolRelease(conn->pool, pipe->ring[i & (PIPELINE_DEPTH - 1)].buffer);
+    }
+    poolRelease(conn->pool, pipe->borrowed);
+    pthread_mutex_destroy(&pipe->lock);
+    pthread_cond_destroy(&pipe->notEmpty);
+    pthread_cond_destroy(&pipe->notFull);
+    free(pipe);
+    conn->pipeline = NULL;
+    return res == 0 ? 0 : -1;
+}
+
+struct pipelineStats getPipelineStats(struct connection* conn){
+    struct pipelineStats stats = {};
+    struct pipeline* pipe = conn->pipeline;
+    if(pipe != NULL){
+        stats.depth = atomic_load(&pipe->tail) - atomic_load(&pipe->head);
+        stats.maxDepth = atomic_load(&pipe->maxDepth);
+        stats.packets = atomic_load(&pipe->packets);
+        stats.producerStalls = atomic_load(&pipe->producerStalls);
+        stats.consumerStalls = atomic_load(&pipe->consumerStalls);
+        stats.fastLaneReplies = atomic_load(&pipe->fastLaneReplies);
+    }
+    return stats;
+}
+
+static void* pipelineWorker(void* arg){
+    struct connection* conn = arg;
+    struct pipeline* pipe = conn->pipeline;
+    while(atomic_load(&pipe->running)){
+        struct pipelineEntry entry = {nullPacket, NULL};
+        byteArray frame = readSocket(conn);
+        if(frame.bytes != NULL){
+            entry.p = parsePacket(conn, &frame, pipe->compression);
+            //recorded as soon as it's framed, so the fast lane packets are in the recording too
+            if(conn->recording != NULL && entry.p.data != NULL){
+                recordPacket(conn->recording, &entry.p, pipe->compression);
+            }
+        }
+        //answered right as they are framed, before the packets ahead of them are applied
+        if(pipe->fastLane && entry.p.data != NULL && answerFastLane(conn, &entry.p, pipe->compression)){
+            poolRelease(conn->pool, conn->inflated);
+            conn->inflated = NULL;
+            continue;
+        }
+        if(entry.p.data != NULL){
+            if(conn->inflated != NULL){ //decompressed packets already live in a pool buffer, so we just take it over
+                entry.buffer = conn->inflated;
+                conn->inflated = NULL;
+            }
+            else{ //the rest has to move out of the receive buffer. Most of it is small, and small packets are carved out of the pool's slabs
+                entry.buffer = poolAcquire(conn->pool, entry.p.size);
+                if(entry.buffer == NULL){
+                    entry.p = nullPacket;
+                }
+                else{
+                    memcpy(entry.buffer, entry.p.data, entry.p.size);
+                    entry.p.data = entry.buffer;
+                }
+            }
+        }
+        //a nullPacket is pushed too, so that the gamestate thread learns about the error in order
+        if(!pipelinePush(pipe, &entry)){
+            poolRelease(conn->pool, entry.buffer);
+            break;
+        }
+        if(entry.p.data == NULL){
+            break;
+        }
+        atomic_fetch_add(&pipe->packets, 1);
+    }
+    pthread_mutex_lock(&pipe->lock);
+    atomic_store(&pipe->finished, true);
+    pthread_cond_broadcast(&pipe->notEmpty);
+    pthread_mutex_unlock(&pipe->lock);
+    return NULL;
+}
+
+static bool answerFastLane(struct connection* conn, const packet* p, int compression){
+    ssize_t res = 0;
+    bool handled = false;
+    pthread_mutex_lock(&conn->sendLock);
+    switch(p->packetId){
+        case KEEP_ALIVE:{
+            res = framePacket(conn, sizeof(int64_t), KEEP_ALIVE_2, p->data, compression, true);
+            handled = true;
+            break;
+        }
+        case PING_PLAY:{
+            res = framePacket(conn, sizeof(int32_t), PONG_PLAY, p->data, compression, true);
+            handled = true;
+            break;
+        }
+        case SYNCHRONIZE_PLAYER_POSITION:{
+            //we confirm right away, but the position itself still has to be applied in order
+            int offset = TELEPORT_ID_OFFSET;
+            int32_t teleportId = readVarInt(p->data, &offset);
+            byte packet[MAX_VAR_INT] = {};
+            size_t sz = writeVarInt(packet, teleportId);
+            res = framePacket(conn, sz, CONFIRM_TELEPORTATION, packet, compression, true);
+            break;
+        }
+        default:{
+            pthread_mutex_unlock(&conn->sendLock);
+            return false;
+        }
+    }
+    pthread_mutex_unlock(&conn->sendLock);
+    if(res > 0){
+        atomic_fetch_add(&conn->pipeline->fastLaneReplies, 1);
+    }
+    return handled;
+}
+
+static bool pipelinePush(struct pipeline* pipe, const struct pipelineEntry* entry){
+    size_t tail = atomic_load_explicit(&pipe->tail, memory_order_relaxed);
+    if(tail - atomic_load(&pipe->head) == PIPELINE_DEPTH){
+        //the apply stage fell behind
+        atomic_fetch_add(&pipe->producerStalls, 1);
+        pthread_mutex_lock(&pipe->lock);
+        atomic_store(&pipe->producerWaiting, true);
+        while(tail - atomic_load(&pipe->head) == PIPELINE_DEPTH && atomic_load(&pipe->running)){
+            pthread_cond_wait(&pipe->notFull, &pipe->lock);
+        }
+        atomic_store(&pipe->producerWaiting, false);
+        pthread_mutex_unlock(&pipe->lock);
+        if(!atomic_load(&pipe->running)){
+            return false;
+        }
+    }
+    pipe->ring[tail & (PIPELINE_DEPTH - 1)] = *entry;
+    atomic_store(&pipe->tail, tail + 1);
+    size_t depth = tail + 1 - atomic_load(&pipe->head);
+    if(depth > atomic_load_explicit(&pipe->maxDepth, memory_order_relaxed)){
+        atomic_store_explicit(&pipe->maxDepth, depth, memory_order_relaxed);
+    }
+    //the consumer sets the flag before checking the ring, so either it sees our entry or we see the flag
+    if(atomic_load(&pipe->consumerWaiting)){
+        pthread_mutex_lock(&pipe->lock);
+        pthread_cond_signal(&pipe->notEmpty);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+    return true;
 }
 
-char* getServerStatus(int socketFd){
-    requestPacket(socketFd, STATUS_REQUEST, NO_COMPRESSION);
+static packet pipelinePop(struct pipeline* pipe){
+    size_t head = atomic_load_explicit(&pipe->head, memory_order_relaxed);
+    if(atomic_load(&pipe->tail) == head){
+        if(atomic_load(&pipe->finished)){
+            return nullPacket;
+        }
+        //waiting on the network
+        atomic_fetch_add(&pipe->consumerStalls, 1);
+        pthread_mutex_lock(&pipe->lock);
+        atomic_store(&pipe->consumerWaiting, true);
+        while(atomic_load(&pipe->tail) == head && !atomic_load(&pipe->finished)){
+            pthread_cond_wait(&pipe->notEmpty, &pipe->lock);
+        }
+        atomic_store(&pipe->consumerWaiting, false);
+        pthread_mutex_unlock(&pipe->lock);
+        if(atomic_load(&pipe->tail) == head){
+            return nullPacket;
+        }
+    }
+    struct pipelineEntry entry = pipe->ring[head & (PIPELINE_DEPTH - 1)];
+    atomic_store(&pipe->head, head + 1);
+    if(atomic_load(&pipe->producerWaiting)){
+        pthread_mutex_lock(&pipe->lock);
+        pthread_cond_signal(&pipe->notFull);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+    pipe->borrowed = entry.buffer;
+    return entry.p;
+}
+
+char* getServerStatus(struct connection* conn){
+    requestPacket(conn, STATUS_REQUEST, NO_COMPRESSION);
     //parse the status
-    packet status = getPacket(socketFd, NO_COMPRESSION);
+    packet status = getPacket(conn, NO_COMPRESSION);
     if(status.packetId != STATUS_RESPONSE){
         return NULL;
     }
@@ -239,163 +943,178 @@ char* getServerStatus(int socketFd){
     int length = readVarInt(status.data, &offset);
     char* rawJson = calloc(length, 1);
     memcpy(rawJson, status.data + offset, length);
-    free(status.data);
+    releasePacket(conn, &status);
     //Might use cJson to parse this
     return rawJson;
 }
 
-int loginState(int socketFd, packet* response, UUID_t* given, const char* username, int* compression){
-    bool login = true;
-    while(login){ //loop for handling the login sequence
-        int offset = 0;
-        switch(response->packetId){
-            case DISCONNECT_LOGIN:; //Disconnected
-                printf("Disconnected:%s\n", readString(response->data, NULL));
-                return 1;
-                break;
-            case ENCRYPTION_REQUEST:; //We are dealing with an online only server... shit
-                //read the data from the request
-                char* serverId = readString(response->data, &offset);
-                byteArray publicKey = readByteArray(response->data, &offset);
-                byteArray verifyToken = readByteArray(response->data, &offset);
-                //generate the secret
-                byte secret[16] = {};
-                if(getentropy(secret, 16) < 0){
-                    return -1;
-                }
-                //now we need to encrypt using AES/CFB8 stream cipher
-                //TODO implement
-                free(serverId);
-                free(publicKey.bytes);
-                free(verifyToken.bytes);
-                break;
-            case LOGIN_SUCCESS:; //Login successful
-                *given = *(UUID_t*)response->data;
-                offset += sizeof(UUID_t);
-                int userNameLen = readVarInt(response->data, &offset);
-                if(memcmp(username, (char*)response->data + offset, userNameLen) != 0){
-                    errno = EINVAL;
-                    return -2;
-                }
-                offset += userNameLen;
-                //int numProperties = readVarInt(response->data, &offset);
-                login = false;
-                break;
-            case SET_COMPRESSION:; //Set compression
-                int compressionInput = readVarInt(response->data, NULL);
-                if(compressionInput > NO_COMPRESSION){
-                    *compression = compressionInput;
-                }
-                break;
-            case LOGIN_PLUGIN_REQUEST:;
-                //Just like the notchian client we send an answer that we didn't understand
-                int messageId = readVarInt(response->data, &offset);
-                //char* channel = readString(response.data, &offset);
-                //free(channel);
-                byte packet[MAX_VAR_INT + 1] = {};
-                int off = writeVarInt(packet, messageId);
-                packet[off] = false;
-                sendPacket(socketFd, off + 1, LOGIN_PLUGIN_RESPONSE, packet, *compression);
-                break;
-            default:;
-                errno = EPROTO;
-                return -3;
+int handleLoginPacket(struct connection* conn, const packet* response, UUID_t* given, const char* username, int* compression){
+    int offset = 0;
+    switch(response->packetId){
+        case DISCONNECT_LOGIN:; //Disconnected
+            char* reason = readString(response->data, NULL);
+            printf("Disconnected:%s\n", reason);
+            free(reason);
+            return 1;
+        case ENCRYPTION_REQUEST:; //We are dealing with an online only server... shit
+            //read the data from the request
+            char* serverId = readString(response->data, &offset);
+            byteArray publicKey = readByteArray(response->data, &offset);
+            byteArray verifyToken = readByteArray(response->data, &offset);
+            //generate the secret
+            byte secret[16] = {};
+            if(getentropy(secret, 16) < 0){
+                return -1;
+            }
+            //now we need to encrypt using AES/CFB8 stream cipher
+            //TODO implement
+            free(serverId);
+            free(publicKey.bytes);
+            free(verifyToken.bytes);
+            break;
+        case LOGIN_SUCCESS:; //Login successful
+            *given = *(UUID_t*)response->data;
+            offset += sizeof(UUID_t);
+            int userNameLen = readVarInt(response->data, &offset);
+            if(memcmp(username, (char*)response->data + offset, userNameLen) != 0){
+                errno = EINVAL;
+                return -2;
+            }
+            offset += userNameLen;
+            //int numProperties = readVarInt(response->data, &offset);
+            return 0;
+        case SET_COMPRESSION:; //Set compression
+            int compressionInput = readVarInt(response->data, NULL);
+            if(compressionInput > NO_COMPRESSION){
+                *compression = compressionInput;
+            }
+            break;
+        case LOGIN_PLUGIN_REQUEST:;
+            //Just like the notchian client we send an answer that we didn't understand
+            int messageId = readVarInt(response->data, &offset);
+            //char* channel = readString(response.data, &offset);
+            //free(channel);
+            byte packet[MAX_VAR_INT + 1] = {};
+            int off = writeVarInt(packet, messageId);
+            packet[off] = false;
+            sendPacket(conn, off + 1, LOGIN_PLUGIN_RESPONSE, packet, *compression);
+            break;
+        default:;
+            errno = EPROTO;
+            return -3;
+    }
+    return LOGIN_PENDING;
+}
+
+int loginState(struct connection* conn, packet* response, UUID_t* given, const char* username, int* compression){
+    while(true){ //loop for handling the login sequence
+        int result = handleLoginPacket(conn, response, given, username, compression);
+        if(result != LOGIN_PENDING){
+            return result;
         }
-        free(response->data);
-        *response = getPacket(socketFd, *compression);
+        releasePacket(conn, response);
+        *response = getPacket(conn, *compression);
         if(packetNull((*response))){
             return -4;
         }
     }
-    return 0;
 }
 
 //Shouldn't leak memory in case of error
-int playState(struct gamestate* current, packet response, int socketFd, int compression, const struct gameVersion* thisVersion){
-    int result = 1; //array indicating current status
-    int index = 0; //current index within backlog
-    packet* backlog = NULL;
-    while(true){ //as long as result == 1
-        //there are some packet types that need immediate answer and separate processing
-        switch (response.packetId){
-            case BUNDLE_DELIMITER:{
-                if(backlog == NULL){
-                    backlog = calloc(MAX_PACKET, sizeof(packet));
-                }
-                else{
-                    //process the backlog
-                    for(int i = 0; i < index; i++){
-                        if(parsePlayPacket(backlog + i, current, thisVersion) != 0){
-                            result = -1;
-                            //free all the following packets
-                            for(int n = i + 1; n < index; n++){
-                                free((backlog + n)->data);
-                            }
-                            free((backlog + i)->data);
-                            break;
+int handlePlayPacket(struct gamestate* current, packet* response, struct connection* conn, int compression, const struct gameVersion* thisVersion){
+    int result = 1;
+    //there are some packet types that need immediate answer and separate processing
+    switch (response->packetId){
+        case BUNDLE_DELIMITER:{
+            if(conn->bundle == NULL){
+                conn->bundle = calloc(MAX_PACKET, sizeof(packet));
+            }
+            else{
+                //process the backlog
+                for(int i = 0; i < conn->bundled; i++){
+                    if(parsePlayPacket(conn->bundle + i, current, thisVersion) != 0){
+                        result = -1;
+                        //free all the following packets
+                        for(int n = i + 1; n < conn->bundled; n++){
+                            free((conn->bundle + n)->data);
                         }
-                        free((backlog + i)->data);
+                        free((conn->bundle + i)->data);
+                        break;
                     }
-                    free(backlog);
-                    backlog = NULL;
-                    index = 0;
+                    free((conn->bundle + i)->data);
                 }
-                free(response.data);
-                break;
+                free(conn->bundle);
+                conn->bundle = NULL;
+                conn->bundled = 0;
             }
-            case DISCONNECT_PLAY:{
-                printf("Disconnected:%s\n", readString(response.data, NULL));
-                result = 0;
-                free(response.data);
-                break;
-            }
-            case KEEP_ALIVE:{
-                int64_t aliveId = *(int64_t*)response.data;
-                sendPacket(socketFd, sizeof(int64_t), KEEP_ALIVE_2, (byte*)&aliveId, compression);
-                free(response.data);
-                break;
-            }
-            case PING_PLAY:{
-                //ping (the vanilla client doesn't respond)
-                int32_t pingId = *(int32_t*)response.data;
-                sendPacket(socketFd, sizeof(int32_t), PONG_PLAY, (byte*)&pingId, compression);
-                free(response.data);
-                break;
-            }
-            case SYNCHRONIZE_PLAYER_POSITION:{
-                //this is the responsive version of the handler
-                int offset = 0;
-                handleSynchronizePlayerPosition(&response, current, &offset);
-                int32_t teleportId = readVarInt(response.data, &offset);
+            break;
+        }
+        case DISCONNECT_PLAY:{
+            char* reason = readString(response->data, NULL);
+            printf("Disconnected:%s\n", reason);
+            free(reason);
+            result = 0;
+            break;
+        }
+        case KEEP_ALIVE:{
+            int64_t aliveId = *(int64_t*)response->data;
+            sendPacket(conn, sizeof(int64_t), KEEP_ALIVE_2, (byte*)&aliveId, compression);
+            break;
+        }
+        case PING_PLAY:{
+            //ping (the vanilla client doesn't respond)
+            int32_t pingId = *(int32_t*)response->data;
+            sendPacket(conn, sizeof(int32_t), PONG_PLAY, (byte*)&pingId, compression);
+            break;
+        }
+        case SYNCHRONIZE_PLAYER_POSITION:{
+            //this is the responsive version of the handler
+            int offset = 0;
+            handleSynchronizePlayerPosition(response, current, &offset);
+            if(conn->pipeline == NULL || !conn->pipeline->fastLane){ //else it has already been confirmed
+                int32_t teleportId = readVarInt(response->data, &offset);
                 byte packet[MAX_VAR_INT] = {};
                 size_t sz = writeVarInt(packet, teleportId);
-                sendPacket(socketFd, sz, CONFIRM_TELEPORTATION, packet, compression);
-                free(response.data);
-                break;
+                sendPacket(conn, sz, CONFIRM_TELEPORTATION, packet, compression);
             }
-            default:{
-                if(backlog == NULL){
-                    //process the packet
-                    if(parsePlayPacket(&response, current, thisVersion) != 0){
-                        result = -2;
-                    }
-                    free(response.data);
-                }
-                else{
-                    backlog[index] = response;
-                    index++;
+            break;
+        }
+        default:{
+            if(conn->bundle == NULL){
+                //process the packet
+                if(parsePlayPacket(response, current, thisVersion) != 0){
+                    result = -2;
                 }
-                break;
             }
+            else if(conn->bundled < MAX_PACKET){
+                //the backlog outlives the borrowed packet, so it needs it's own copy
+                conn->bundle[conn->bundled] = keepPacket(response);
+                conn->bundled++;
+            }
+            break;
         }
+    }
+    releasePacket(conn, response);
+    return result;
+}
+
+int playState(struct gamestate* current, packet response, struct connection* conn, int compression, const struct gameVersion* thisVersion){
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int64_t elapsed = 0; //microseconds already handed to the gamestate
+    while(true){
+        int result = handlePlayPacket(current, &response, conn, compression, thisVersion);
         if(result != 1){
-            break;
+            return result;
         }
-        response = getPacket(socketFd, compression);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t total = (int64_t)(now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+        advanceGamestate(current, total - elapsed);
+        elapsed = total;
+        response = getPacket(conn, compression);
         if(packetNull(response)){
             perror("Error while getting a packet");
             return -3;
         }
-    };
-    return result;
+    }
 }
@@ -4,8 +4,11 @@
 #include <stdio.h>
 #include <sys/types.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <zlib.h>
 #include "mcTypes.h"
 #include "gamestateMc.h"
+#include "bufferPool.h"
 
 //Constants definitions
 
@@ -16,8 +19,125 @@
 #define STATUS_STATE 1
 #define LOGIN_STATE 2
 
+#define LOGIN_PENDING 2 //returned by handleLoginPacket while the login sequence goes on
+
+#define TELEPORT_ID_OFFSET (3 * sizeof(double) + 2 * sizeof(float) + sizeof(byte)) //offset of the teleport id within SYNCHRONIZE_PLAYER_POSITION
+
+#define RECEIVE_BLOCK 65536 //the amount of bytes we try to get out of the socket with a single read
+
+#define DEFAULT_COMPRESSION_LEVEL Z_BEST_SPEED //outbound packets barely go over the threshold, so higher levels are wasted CPU
+#define DEFLATE_WINDOW_BITS 12 //4KB window, which is more than most serverbound packets
+#define DEFLATE_MEM_LEVEL 4
+
+//Types
+
+//The optional reader/parser pipeline of a connection
+struct pipeline;
+
+//An open recording of the packets received over a connection, see recordingMc.h
+struct recording;
+
+/*!
+ @struct pipelineStats
+ @brief Counters describing how well the gamestate thread keeps up with the I/O thread of a pipeline
+ @param depth the number of packets framed but not yet applied
+ @param maxDepth the highest depth seen so far
+ @param packets the number of packets framed by the I/O thread
+ @param producerStalls how many times the I/O thread found the ring full, meaning the apply stage fell behind
+ @param consumerStalls how many times the gamestate thread found the ring empty and had to wait for the network
+ @param fastLaneReplies the number of replies sent straight from the I/O thread
+*/
+struct pipelineStats{
+    size_t depth;
+    size_t maxDepth;
+    uint64_t packets;
+    uint64_t producerStalls;
+    uint64_t consumerStalls;
+    uint64_t fastLaneReplies;
+};
+
+/*!
+ @struct connection
+ @brief A connection to a Minecraft server alongside all the buffers that belong to it
+ @param socketFd file descriptor of the underlying socket
+ @param sendLock serializes everything that writes to the socket, since the pipeline may send from it's own thread
+ @param in buffer holding bytes read from the socket that haven't been framed yet
+ @param inflater inflate stream that is reset, rather than recreated, for every compressed packet
+ @param pool pool of size classed buffers that decompressed packets are written to, and that pipelined packets are copied into
+ @param inflated the pool buffer holding the currently borrowed packet, or NULL
+ @param deflater deflate stream that is reset, rather than recreated, for every compressed packet we send
+ @param out buffer that sent packets are collected in while the connection is corked, or while a non-blocking socket is full
+ @param pipeline the running pipeline, or NULL if packets are read on the calling thread
+ @param bundle copies of the packets received since an opening BUNDLE_DELIMITER, or NULL outside of a bundle
+ @param bundled the number of packets in bundle
+ @param recording the recording every packet returned by getPacket is appended to, or NULL
+*/
+struct connection{
+    int socketFd;
+    pthread_mutex_t sendLock;
+    struct receiveBuffer{
+        byte* bytes;
+        size_t capacity;
+        size_t start; //index of the first byte that hasn't been framed yet
+        size_t end; //index right after the last byte read from the socket
+    } in;
+    z_stream inflater;
+    bufferPool* pool;
+    byte* inflated;
+    z_stream deflater;
+    struct sendBuffer{
+        byte* bytes;
+        size_t capacity;
+        size_t len;
+        size_t ready; //the leading bytes that may be written right away, the rest waits for flushConnection
+        bool corked; //if true packets are only written to the socket on flushConnection
+        bool flushing; //if true a flushConnection batch is still waiting for the socket, and the connection is uncorked once it's written
+    } out;
+    struct pipeline* pipeline;
+    packet* bundle;
+    int bundled;
+    struct recording* recording;
+};
+
 //Functions
 
+/*!
+ @brief Wraps a connected socket in a connection struct
+ @param socketFd file descriptor that identifies a properly configured socket
+ @return a newly allocated connection, or NULL on error
+*/
+struct connection* initConnection(int socketFd);
+
+/*!
+ @brief Starts a separate I/O thread that frames and decompresses packets ahead of time, so that a slow parsePlayPacket doesn't delay reading. getPacket then hands out packets from the pipeline, in order
+ @param conn the connection to read from. Nothing but getPacket may read from it while the pipeline runs
+ @param compression the established compression level. The compression argument of getPacket is ignored while the pipeline runs
+ @param current the packet currently borrowed from conn, or NULL. It gets moved into memory owned by the pipeline
+ @param fastLane if true KEEP_ALIVE and PING_PLAY are answered by the I/O thread as soon as they are framed and never reach getPacket. SYNCHRONIZE_PLAYER_POSITION is confirmed the same way, but still reaches getPacket to be applied
+ @return 0 on success, -1 for error, in which case current stays borrowed from conn
+*/
+int startPipeline(struct connection* conn, int compression, packet* current, bool fastLane);
+
+/*!
+ @brief Stops the pipeline and drops all the packets that haven't been read. Shuts down the reading side of the socket
+ @param conn the connection whose pipeline should stop
+ @return 0 on success, -1 for error
+*/
+int stopPipeline(struct connection* conn);
+
+/*!
+ @brief Gets the current pipeline counters
+ @param conn the connection with a running pipeline
+ @return the counters, all zeroed if there is no pipeline
+*/
+struct pipelineStats getPipelineStats(struct connection* conn);
+
+/*!
+ @brief Frees the connection and all of it's buffers, stopping the pipeline and recording if they run. Doesn't close the socket
+ @param conn the connection to free
+*/
+void freeConnection(struct connection* conn);
+
 /*! 
  @brief Connects the given socket to the given host to the given port
  @param socketFd file descriptor that identifies a properly configured socket
@@ -28,87 +148,158 @@
 int connectSocket(int socketFd, const char* host, int port);
 
 /*! 
- @brief Sends the given packet to the Minecraft server in the correct format
- @param socketFd file descriptor that identifies a properly configured socket
+ @brief Sends the given packet to the Minecraft server in the correct format. The whole frame leaves in a single syscall
+ @param conn the connection to the server
  @param size the size of data
  @param packetId an id that identifies the packet in the Minecraft protocol
  @param data the values of fields of the packet
  @param compression the compression level established, or NO_COMPRESSION
- @return the number of bytes written, EOF or -1 for error
+ @return the number of bytes written, or queued if the connection is corked, EOF or -1 for error
+*/
+ssize_t sendPacket(struct connection* conn, int size, int packetId, const byte* data, int compression);
+
+/*!
+ @brief Sets the zlib level used to compress packets sent over the connection. DEFAULT_COMPRESSION_LEVEL unless changed
+ @param conn the connection
+ @param level 0 to 9, where 0 means stored blocks and 1 means the fastest compression, or Z_DEFAULT_COMPRESSION
+ @return 0 on success, -1 for error
+*/
+int setCompressionLevel(struct connection* conn, int level);
+
+/*!
+ @brief Corks the connection, so that all packets sent from now on are collected and written together by flushConnection. Call this at the start of a tick
+ @param conn the connection to cork
+*/
+void corkConnection(struct connection* conn);
+
+/*!
+ @brief Writes all the packets collected since corkConnection in a single syscall and uncorks the connection. Call this at the end of a tick
+ @param conn the connection to flush
+ @return the number of bytes written or -1 for error. With a non-blocking socket some bytes may stay queued, see queuedBytes, in which case the connection stays corked until drainConnection has written them
 */
-ssize_t sendPacket(int socketFd, int size, int packetId, const byte* data, int compression);
+ssize_t flushConnection(struct connection* conn);
+
+/*!
+ @brief Writes the bytes that a full non-blocking socket didn't take yet, leaving the packets collected while corked alone. Uncorks the connection once the batch of an earlier flushConnection is fully written. Call this whenever the socket becomes writable
+ @param conn the connection to drain
+ @return the number of bytes written or -1 for error
+*/
+ssize_t drainConnection(struct connection* conn);
+
+/*!
+ @brief Gets the number of bytes that a full non-blocking socket didn't take yet. flushConnection writes them once the socket is writable again
+ @param conn the connection
+ @return the number of bytes waiting for the socket, not counting packets collected while corked
+*/
+size_t queuedBytes(struct connection* conn);
 
 /*!
  @brief Reads the packet form socket, and parses it. Will attempt to read the packet and parse it until timeout or error, at which point it will return a NULL 
- @param socketFd the socket file descriptor
+ @param conn the connection to read from. Bytes are read from the socket in large blocks, so a single read can yield many packets. If the socket is non-blocking and the packet hasn't fully arrived yet a nullPacket is returned with errno set to EAGAIN, and the partial packet stays buffered
  @param compression the established compression level
- @return a parsed packet, or a nullPacket
+ @return a parsed packet, or a nullPacket. The packet data is borrowed from conn and is only valid until releasePacket or the next getPacket call on conn. Don't free it
+*/
+packet getPacket(struct connection* conn, int compression);
+
+/*!
+ @brief Gives the memory borrowed by a packet returned from getPacket back to the connection
+ @param conn the connection the packet was read from
+ @param borrowed the packet to release, it's data is set to NULL
+*/
+void releasePacket(struct connection* conn, packet* borrowed);
+
+/*!
+ @brief Copies a borrowed packet into memory owned by the caller, so that it outlives the next getPacket call
+ @param borrowed the packet returned by getPacket
+ @return a packet whose data must be freed with free(), or a nullPacket on error
 */
-packet getPacket(int socketFd, int compression);
+packet keepPacket(const packet* borrowed);
 
 /*!
  @brief Requests a packet from server in the correct format
- @param socketFd the socket file descriptor
+ @param conn the connection to the server
  @param packetType the packetId being requested
  @param compression the established compression level
  @return the number of bytes written, EOF or -1 for error
 */
-ssize_t requestPacket(int socketFd, int packetType, int compression);
+ssize_t requestPacket(struct connection* conn, int packetType, int compression);
 
 /*!
  @brief Performs a specific handshake with the server
- @param socketFd the socket file descriptor
+ @param conn the connection to the server
  @param host the host name (address) of the server
  @param protocol the protocol version utilized by the client
  @param port the port that we are connected to
  @param nextState what will be requested next
  @return the number of bytes written, EOF or -1 for error
 */
-ssize_t handshake(int socketFd, const char* host, int32_t protocol, uint16_t port, int32_t nextState);
+ssize_t handshake(struct connection* conn, const char* host, int32_t protocol, uint16_t port, int32_t nextState);
 
 /*!
  @brief Performs a ping-pong interaction with the server and returns the delay
- @param socketFd the socket file descriptor
+ @param conn the connection to the server
  @return the difference between the value sent to the server in Ping and the value received in Pong, or < 0 for error
 */
-int64_t pingPong(int socketFd);
+int64_t pingPong(struct connection* conn);
 
 /*!
  @brief Starts the login process
- @param socketFd the socket file descriptor
+ @param conn the connection to the server
  @param name our client user name
  @param player our client UUID
  @return the number of bytes written, EOF or -1 for error
 */
-ssize_t startLogin(int socketFd, const char* name, const UUID_t* player);
+ssize_t startLogin(struct connection* conn, const char* name, const UUID_t* player);
 
 /*!
  @brief Requests the status from server after handshake indicating STATUS_STATE
- @param socketFd the socket file descriptor
+ @param conn the connection to the server
  @return raw json the server responded with
 */
-char* getServerStatus(int socketFd);
+char* getServerStatus(struct connection* conn);
+
+/*!
+ @brief Handles a single packet received in login state, without reading the next one
+ @param conn the connection to the server
+ @param response the received packet, borrowed from conn. It isn't released
+ @param given the current player UUID, gets updated to the UUID provided by the server
+ @param username the player username
+ @param compression pointer to the current compression level
+ @return LOGIN_PENDING if more login packets are to come, 0 once the login succeeded, negative values for errors and positive values for graceful disconnects
+*/
+int handleLoginPacket(struct connection* conn, const packet* response, UUID_t* given, const char* username, int* compression);
 
 /*!
  @brief Performs the login process
- @param socketFd the socket file descriptor
- @param response pointer to the most recent response in login state, gets updated to the most recent received packet
+ @param conn the connection to the server
+ @param response pointer to the most recent response in login state, gets updated to the most recent received packet. Both are borrowed from conn
  @param given the current player UUID, gets updated to the UUID provided by the server
  @param username the player username
  @param compression pointer to the current compression level
  @return the result of the process. Negative values indicate errors, positive values indicates graceful disconnects
 */
-int loginState(int socketFd, packet* response, UUID_t* given, const char* username, int* compression);
+int loginState(struct connection* conn, packet* response, UUID_t* given, const char* username, int* compression);
+
+/*!
+ @brief Handles a single packet received in play state, answering it if necessary, without reading the next one
+ @param current struct containing the current gamestate
+ @param response the received packet, borrowed from conn. It gets released
+ @param conn the connection used for communication with the server
+ @param compression the established compression level
+ @param thisVersion a previously created version struct
+ @return 1 if the play state goes on. Negative values indicate errors. 0 indicates server ordered disconnect
+*/
+int handlePlayPacket(struct gamestate* current, packet* response, struct connection* conn, int compression, const struct gameVersion* thisVersion);
 
 /*!
- @brief Keeps the current struct updated based on input from the server. Ideally run this in a thread.
+ @brief Keeps the current struct updated based on input from the server, and runs its client ticks as time passes. Ideally run this in a thread.
  @param current struct containing the current gamestate
- @param response the unparsed packet from the login state
- @param socketFd the file descriptor of the socket used for communication with the server
+ @param response the unparsed packet from the login state, borrowed from conn
+ @param conn the connection used for communication with the server
  @param compression the established compression level
  @param thisVersion a previously created version struct
  @return the result of the process. Negative values indicate errors. 0 indicates server ordered disconnect
 */
-int playState(struct gamestate* current, packet response, int socketFd, int compression, const struct gameVersion* thisVersion);
+int playState(struct gamestate* current, packet response, struct connection* conn, int compression, const struct gameVersion* thisVersion);
 
 #endif
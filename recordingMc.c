@@ -0,0 +1,217 @@
+#include "recordingMc.h"
+#include "networkingMc.h"
+#include "gamestateMc.h"
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+
+#if defined(__unix__)
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#elif defined(_WIN32)
+#include <io.h>
+#define NULL_DEVICE "NUL"
+#endif
+
+#define RECORD_HEADER (MAX_VAR_INT * 4) //room for the four VarInts in front of the payload
+
+//Private functions
+
+/*!
+ @brief Reads a single VarInt from the file
+ @param file the file to read from
+ @param value pointer to where the value should be stored
+ @return 0 on success, -1 on EOF or a malformed VarInt
+*/
+static int readFileVarInt(FILE* file, int32_t* value);
+
+/*!
+ @brief Gets the number of seconds between two points in time
+ @param from the earlier point in time
+ @param to the later point in time
+ @return the number of seconds
+*/
+static double timeBetween(const struct timespec* from, const struct timespec* to);
+
+int startRecording(struct connection* conn, const char* path){
+    if(conn->recording != NULL){
+        errno = EALREADY;
+        return -1;
+    }
+    struct recording* rec = calloc(1, sizeof(struct recording));
+    if(rec == NULL){
+        return -1;
+    }
+    rec->file = fopen(path, "wb");
+    if(rec->file == NULL){
+        free(rec);
+        return -1;
+    }
+    fwrite(RECORDING_MAGIC, 1, strlen(RECORDING_MAGIC), rec->file);
+    fputc(RECORDING_VERSION, rec->file);
+    clock_gettime(CLOCK_MONOTONIC, &rec->last);
+    conn->recording = rec;
+    return 0;
+}
+
+int recordPacket(struct recording* rec, const packet* p, int compression){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double delay = timeBetween(&rec->last, &now) * 1e6;
+    rec->last = now;
+    byte header[RECORD_HEADER] = {};
+    size_t offset = writeVarInt(header, delay < INT32_MAX ? (int32_t)delay : INT32_MAX);
+    offset += writeVarInt(header + offset, p->packetId);
+    offset += writeVarInt(header + offset, compression + 1);
+    offset += writeVarInt(header + offset, p->size);
+    if(fwrite(header, 1, offset, rec->file) != offset || fwrite(p->data, 1, p->size, rec->file) != (size_t)p->size){
+        return -1;
+    }
+    rec->packets++;
+    rec->bytes += p->size;
+    return 0;
+}
+
+int stopRecording(struct connection* conn){
+    struct recording* rec = conn->recording;
+    if(rec == NULL){
+        return 0;
+    }
+    conn->recording = NULL;
+    int result = fclose(rec->file) == 0 ? 0 : -1;
+    free(rec);
+    return result;
+}
+
+FILE* openRecording(const char* path){
+    FILE* file = fopen(path, "rb");
+    if(file == NULL){
+        return NULL;
+    }
+    char magic[sizeof(RECORDING_MAGIC)] = {};
+    if(fread(magic, 1, strlen(RECORDING_MAGIC), file) != strlen(RECORDING_MAGIC) || strcmp(magic, RECORDING_MAGIC) != 0 || fgetc(file) != RECORDING_VERSION){
+        fclose(file);
+        errno = EINVAL;
+        return NULL;
+    }
+    return file;
+}
+
+int readRecordedPacket(FILE* file, packet* p, size_t* capacity, int32_t* delay, int* compression){
+    int32_t packetId, storedCompression, size;
+    if(readFileVarInt(file, delay) != 0){ //a clean end of the recording
+        return 1;
+    }
+    if(readFileVarInt(file, &packetId) != 0 || readFileVarInt(file, &storedCompression) != 0 || readFileVarInt(file, &size) != 0 || size < 0){
+        return -1;
+    }
+    if((size_t)size > *capacity){
+        byte* newData = realloc(p->data, size);
+        if(newData == NULL){
+            return -1;
+        }
+        p->data = newData;
+        *capacity = size;
+    }
+    if(fread(p->data, 1, size, file) != (size_t)size){
+        return -1;
+    }
+    p->packetId = packetId;
+    p->size = size;
+    *compression = storedCompression - 1;
+    return 0;
+}
+
+int replayRecording(const char* path, struct gamestate* current, const struct gameVersion* thisVersion, bool realTime, struct replayStats* stats){
+    FILE* file = openRecording(path);
+    if(file == NULL){
+        return -1;
+    }
+    //replies still get framed and compressed, they just don't go anywhere
+    int nullFd = open(NULL_DEVICE, O_WRONLY);
+    struct connection* conn = nullFd < 0 ? NULL : initConnection(nullFd);
+    if(conn == NULL){
+        if(nullFd >= 0){
+            close(nullFd);
+        }
+        fclose(file);
+        return -1;
+    }
+    struct replayStats local = {};
+    if(stats == NULL){
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(struct replayStats));
+    byte* payload = NULL;
+    size_t capacity = 0;
+    int result = 0;
+    packet p = nullPacket;
+    struct timespec start, due;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    due = start;
+    while(result == 0){
+        int32_t delay;
+        int compression;
+        p.data = payload;
+        int read = readRecordedPacket(file, &p, &capacity, &delay, &compression);
+        payload = p.data;
+        if(read != 0){
+            result = read > 0 ? 0 : -1;
+            break;
+        }
+        if(realTime){
+            due.tv_nsec += (long)(delay % 1000000) * 1000;
+            due.tv_sec += delay / 1000000 + due.tv_nsec / 1000000000;
+            due.tv_nsec %= 1000000000;
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            double wait = timeBetween(&now, &due);
+            if(wait > 0){
+                struct timespec pause = {(time_t)wait, (long)((wait - (time_t)wait) * 1e9)};
+                nanosleep(&pause, NULL);
+            }
+        }
+        //the recorded delays are the time that passed in the game, however fast it's replayed
+        advanceGamestate(current, delay);
+        int size = p.size;
+        int handled = handlePlayPacket(current, &p, conn, compression, thisVersion);
+        stats->packets++;
+        stats->bytes += size;
+        if(handled == 0){
+            result = 1;
+        }
+        else if(handled < 0){
+            stats->errors++;
+        }
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats->seconds = timeBetween(&start, &end);
+    free(payload);
+    freeConnection(conn);
+    close(nullFd);
+    fclose(file);
+    return result;
+}
+
+static int readFileVarInt(FILE* file, int32_t* value){
+    uint32_t result = 0;
+    for(int i = 0; i < MAX_VAR_INT; i++){
+        int c = fgetc(file);
+        if(c == EOF){
+            return -1;
+        }
+        result |= (uint32_t)(c & SEGMENT_BITS) << (7 * i);
+        if((c & CONTINUE_BIT) == 0){
+            *value = (int32_t)result;
+            return 0;
+        }
+    }
+    errno = EOVERFLOW;
+    return -1;
+}
+
+static double timeBetween(const struct timespec* from, const struct timespec* to){
+    return (double)(to->tv_sec - from->tv_sec) + (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
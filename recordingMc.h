@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "mcTypes.h"
+
+//Recording of every packet framed on a connection, and replaying such recordings into a gamestate without a server
+
+#ifndef RECORDING_MC
+#define RECORDING_MC
+
+#define RECORDING_MAGIC "SCRC"
+#define RECORDING_VERSION 1
+
+/*Recording format note
+The file starts with RECORDING_MAGIC followed by a single RECORDING_VERSION byte. Then every packet is stored as:
+VarInt microseconds since the previous packet | VarInt packet id | VarInt compression + 1 | VarInt payload size | payload
+The payload is stored decompressed, exactly as getPacket handed it out. Compression is stored off by one so that NO_COMPRESSION fits in a single byte
+*/
+
+struct connection;
+struct gamestate;
+struct gameVersion;
+
+/*!
+ @struct recording
+ @brief An open recording file
+ @param file the file packets are appended to
+ @param last when the previous packet was framed
+ @param packets the number of packets recorded so far
+ @param bytes the number of payload bytes recorded so far
+*/
+struct recording{
+    FILE* file;
+    struct timespec last;
+    uint64_t packets;
+    uint64_t bytes;
+};
+
+/*!
+ @struct replayStats
+ @brief What a replay has done, for measuring gamestate throughput
+ @param packets the number of packets replayed
+ @param bytes the number of payload bytes replayed
+ @param errors the number of packets the gamestate failed to parse
+ @param seconds the wall clock time the replay took
+*/
+struct replayStats{
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t errors;
+    double seconds;
+};
+
+/*!
+ @brief Starts recording every packet framed on the connection, including the ones the fast lane of a pipeline answers itself. Each packet is stamped with the time it was framed, not when it was applied. Start it right after the login, before startPipeline, to get a recording that can be replayed
+ @param conn the connection to record
+ @param path the path of the recording file, which gets overwritten
+ @return 0 on success, -1 for error
+*/
+int startRecording(struct connection* conn, const char* path);
+
+/*!
+ @brief Appends the packet to the recording, with the time since the previous one as it's delay. Call it right after framing the packet
+ @param rec the recording
+ @param p the packet
+ @param compression the compression level the packet was received with
+ @return 0 on success, -1 for error
+*/
+int recordPacket(struct recording* rec, const packet* p, int compression);
+
+/*!
+ @brief Stops recording the connection and closes the recording file. Called by freeConnection
+ @param conn the recorded connection
+ @return 0 on success, -1 for error
+*/
+int stopRecording(struct connection* conn);
+
+/*!
+ @brief Opens a recording file for reading and checks it's header
+ @param path the path of the recording file
+ @return the file positioned at the first packet, or NULL on error
+*/
+FILE* openRecording(const char* path);
+
+/*!
+ @brief Reads the next packet from a recording opened with openRecording
+ @param file the recording file
+ @param p the packet to read into. It's data is a buffer owned by the caller, which gets reallocated if it's too small. Free it with free()
+ @param capacity pointer to the size of the buffer p->data points to
+ @param delay pointer to where the microseconds since the previous packet should be stored
+ @param compression pointer to where the compression level the packet was received with should be stored
+ @return 0 on success, 1 at the end of the recording, -1 for error
+*/
+int readRecordedPacket(FILE* file, packet* p, size_t* capacity, int32_t* delay, int* compression);
+
+/*!
+ @brief Feeds a recording through the play state packet handling, with replies written to the null device instead of a socket
+ @param path the path of the recording file
+ @param current the gamestate to apply the packets to
+ @param thisVersion a previously created version struct
+ @param realTime if true the packets are spaced out as they were recorded, else they are replayed as fast as possible
+ @param stats pointer to the stats to fill in, or NULL
+ @return 0 if the whole recording was replayed, 1 if it ended with a server ordered disconnect, or -1 for error
+*/
+int replayRecording(const char* path, struct gamestate* current, const struct gameVersion* thisVersion, bool realTime, struct replayStats* stats);
+
+#endif
@@ -0,0 +1,344 @@
+#include "registryMc.h"
+
+#include <string.h>
+#include <errno.h>
+
+/*Registry note
+Every registry in the codec is a compound holding a list of {name, id, element} compounds.
+Each registry is read in two passes over it's list: the first validates the ids and finds the largest one, so the table is allocated once, and the second decodes the elements into it.
+Every entry struct starts with it's name, so the registries are filled and freed by the same generic functions, and a NULL name marks an id the server never sent
+*/
+
+#define MAX_DIMENSION_HEIGHT 4064 //the tallest dimension the game allows
+
+const struct dimensionType defaultDimensionType = {
+    .name = (identifier)"minecraft:overworld",
+    .minY = -64,
+    .height = 384,
+    .logicalHeight = 384,
+    .coordinateScale = 1.0,
+    .ambientLight = 0.0f,
+    .hasSkylight = true,
+    .hasCeiling = false,
+    .ultrawarm = false,
+    .natural = true
+};
+
+//Private functions
+
+//Decodes the element of an entry into the entry. Returns 0 on success, -1 for error and -2 if the element is malformed
+typedef int (*readEntryFunction)(nbt_view element, void* entry);
+
+//Frees everything an entry points to, but not the entry itself
+typedef void (*freeEntryFunction)(void* entry);
+
+/*!
+ @brief Copies a string view into a new NULL-terminated string
+ @param view the view
+ @return the string, or NULL if the view isn't a string or on error
+*/
+static char* copyViewString(nbt_view view);
+
+/*!
+ @brief Reads a single registry out of the codec into a table indexed by id
+ @param codec the registry codec
+ @param name the name of the registry
+ @param table pointer to where the table should be stored
+ @param count pointer to where the number of entries in the table should be stored
+ @param entrySize the size of a single entry, which must start with an identifier
+ @param readEntry the function decoding the elements
+ @param freeEntry the function freeing the entries
+ @return 0 on success, -1 for error, -2 if the registry is malformed
+*/
+static int readRegistry(nbt_view codec, const char* name, void** table, size_t* count, size_t entrySize, readEntryFunction readEntry, freeEntryFunction freeEntry);
+
+/*!
+ @brief Frees a table of entries
+ @param table the table
+ @param count the number of entries
+ @param entrySize the size of a single entry
+ @param freeEntry the function freeing the entries
+*/
+static void freeRegistry(void* table, size_t count, size_t entrySize, freeEntryFunction freeEntry);
+
+static int readDimensionType(nbt_view element, void* data);
+
+static int readChatType(nbt_view element, void* data);
+
+static int readChatDecoration(nbt_view decoration, struct chatDecoration* out);
+
+static int readDamageType(nbt_view element, void* data);
+
+static int readBiome(nbt_view element, void* data);
+
+static void freeChatDecoration(struct chatDecoration* decoration);
+
+static void freeChatType(void* data);
+
+static void freeDamageType(void* data);
+
+//Entries that only own their name need nothing else freed
+static void freeNothing(void* entry);
+
+int readRegistries(nbt_view codec, struct registries* out){
+    if(codec.type != TAG_COMPOUND){
+        errno = EINVAL;
+        return -1;
+    }
+    int res = readRegistry(codec, DIMENSION_TYPE_REGISTRY, (void**)&out->dimensionTypes, &out->dimensionTypeCount, sizeof(struct dimensionType), readDimensionType, freeNothing);
+    if(res == 0){
+        res = readRegistry(codec, CHAT_TYPE_REGISTRY, (void**)&out->chatTypes, &out->chatTypeCount, sizeof(struct chatType), readChatType, freeChatType);
+    }
+    if(res == 0){
+        res = readRegistry(codec, DAMAGE_TYPE_REGISTRY, (void**)&out->damageTypes, &out->damageTypeCount, sizeof(struct damageType), readDamageType, freeDamageType);
+    }
+    if(res == 0){
+        res = readRegistry(codec, BIOME_REGISTRY, (void**)&out->biomes, &out->biomeCount, sizeof(struct biome), readBiome, freeNothing);
+    }
+    if(res != 0){
+        freeRegistries(out);
+    }
+    return res;
+}
+
+const struct dimensionType* findDimensionType(const struct registries* registries, const char* name){
+    if(name == NULL){
+        return NULL;
+    }
+    for(size_t i = 0; i < registries->dimensionTypeCount; i++){
+        const struct dimensionType* d = registries->dimensionTypes + i;
+        if(d->name != NULL && strcmp(d->name, name) == 0){
+            return d;
+        }
+    }
+    return NULL;
+}
+
+void freeRegistries(struct registries* registries){
+    freeRegistry(registries->dimensionTypes, registries->dimensionTypeCount, sizeof(struct dimensionType), freeNothing);
+    freeRegistry(registries->chatTypes, registries->chatTypeCount, sizeof(struct chatType), freeChatType);
+    freeRegistry(registries->damageTypes, registries->damageTypeCount, sizeof(struct damageType), freeDamageType);
+    freeRegistry(registries->biomes, registries->biomeCount, sizeof(struct biome), freeNothing);
+    memset(registries, 0, sizeof(struct registries));
+}
+
+static char* copyViewString(nbt_view view){
+    size_t length = 0;
+    const char* chars = nbt_view_string(view, &length);
+    if(chars == NULL){
+        return NULL;
+    }
+    char* result = malloc(length + 1);
+    if(result == NULL){
+        return NULL;
+    }
+    memcpy(result, chars, length);
+    result[length] = '\0';
+    return result;
+}
+
+static int readRegistry(nbt_view codec, const char* name, void** table, size_t* count, size_t entrySize, readEntryFunction readEntry, freeEntryFunction freeEntry){
+    *table = NULL;
+    *count = 0;
+    nbt_view registry = nbt_view_find(codec, name);
+    if(registry.type == TAG_INVALID){
+        return 0; //a registry the server didn't send is simply empty
+    }
+    nbt_view entries = nbt_view_find(registry, "value");
+    if(registry.type != TAG_COMPOUND || entries.type != TAG_LIST){
+        return -2;
+    }
+    //the first pass finds the size of the table
+    size_t size = 0;
+    nbt_view_iterator it = nbt_view_children(entries);
+    nbt_view entry;
+    while(nbt_view_next(&it, &entry)){
+        int32_t id = nbt_view_int(nbt_view_find(entry, "id"), -1);
+        if(entry.type != TAG_COMPOUND || id < 0 || id > MAX_REGISTRY_ID){
+            return -2;
+        }
+        if((size_t)id >= size){
+            size = (size_t)id + 1;
+        }
+    }
+    if(size == 0){
+        return 0;
+    }
+    byte* result = calloc(size, entrySize);
+    if(result == NULL){
+        return -1;
+    }
+    it = nbt_view_children(entries);
+    while(nbt_view_next(&it, &entry)){
+        byte* slot = result + (size_t)nbt_view_int(nbt_view_find(entry, "id"), 0) * entrySize;
+        if(*(identifier*)slot != NULL){ //the server sent the same id twice
+            freeRegistry(result, size, entrySize, freeEntry);
+            return -2;
+        }
+        int res = readEntry(nbt_view_find(entry, "element"), slot);
+        if(res == 0){
+            *(identifier*)slot = copyViewString(nbt_view_find(entry, "name"));
+            if(*(identifier*)slot == NULL){
+                res = nbt_view_find(entry, "name").type == TAG_STRING ? -1 : -2;
+            }
+        }
+        if(res != 0){
+            freeEntry(slot); //the entry may be partially read
+            freeRegistry(result, size, entrySize, freeEntry);
+            return res;
+        }
+    }
+    *table = result;
+    *count = size;
+    return 0;
+}
+
+static void freeRegistry(void* table, size_t count, size_t entrySize, freeEntryFunction freeEntry){
+    if(table == NULL){
+        return;
+    }
+    for(size_t i = 0; i < count; i++){
+        byte* slot = (byte*)table + i * entrySize;
+        if(*(identifier*)slot != NULL){
+            free(*(identifier*)slot);
+            freeEntry(slot);
+        }
+    }
+    free(table);
+}
+
+static int readDimensionType(nbt_view element, void* data){
+    struct dimensionType* entry = data;
+    if(element.type != TAG_COMPOUND){
+        return -2;
+    }
+    entry->minY = nbt_view_int(nbt_view_find(element, "min_y"), defaultDimensionType.minY);
+    entry->height = nbt_view_int(nbt_view_find(element, "height"), defaultDimensionType.height);
+    //chunks are allocated based on these, so they are checked just like the game checks them
+    if(entry->minY % 16 != 0 || entry->height % 16 != 0 || entry->height <= 0 || entry->height > MAX_DIMENSION_HEIGHT || entry->minY < -MAX_DIMENSION_HEIGHT / 2 || entry->minY + entry->height > MAX_DIMENSION_HEIGHT / 2){
+        return -2;
+    }
+    entry->logicalHeight = nbt_view_int(nbt_view_find(element, "logical_height"), entry->height);
+    entry->coordinateScale = nbt_view_double(nbt_view_find(element, "coordinate_scale"), 1.0);
+    entry->ambientLight = nbt_view_float(nbt_view_find(element, "ambient_light"), 0.0f);
+    entry->hasSkylight = nbt_view_byte(nbt_view_find(element, "has_skylight"), 0) != 0;
+    entry->hasCeiling = nbt_view_byte(nbt_view_find(element, "has_ceiling"), 0) != 0;
+    entry->ultrawarm = nbt_view_byte(nbt_view_find(element, "ultrawarm"), 0) != 0;
+    entry->natural = nbt_view_byte(nbt_view_find(element, "natural"), 0) != 0;
+    return 0;
+}
+
+static int readChatType(nbt_view element, void* data){
+    struct chatType* entry = data;
+    if(element.type != TAG_COMPOUND){
+        return -2;
+    }
+    int res = readChatDecoration(nbt_view_find(element, "chat"), &entry->chat);
+    if(res != 0){
+        return res;
+    }
+    return readChatDecoration(nbt_view_find(element, "narration"), &entry->narration);
+}
+
+static int readChatDecoration(nbt_view decoration, struct chatDecoration* out){
+    if(decoration.type == TAG_INVALID){
+        return 0; //a chat type may lack a narration
+    }
+    nbt_view key = nbt_view_find(decoration, "translation_key");
+    nbt_view parameters = nbt_view_find(decoration, "parameters");
+    if(decoration.type != TAG_COMPOUND || key.type != TAG_STRING || (parameters.type != TAG_LIST && parameters.type != TAG_INVALID)){
+        return -2;
+    }
+    out->translationKey = copyViewString(key);
+    if(out->translationKey == NULL){
+        return -1;
+    }
+    int32_t count = nbt_view_length(parameters);
+    if(count <= 0){
+        return 0;
+    }
+    out->parameters.arr = calloc(count, sizeof(char*));
+    if(out->parameters.arr == NULL){
+        return -1;
+    }
+    nbt_view_iterator it = nbt_view_children(parameters);
+    nbt_view parameter;
+    while(nbt_view_next(&it, &parameter)){
+        if(parameter.type != TAG_STRING){
+            return -2;
+        }
+        out->parameters.arr[out->parameters.len] = copyViewString(parameter);
+        if(out->parameters.arr[out->parameters.len] == NULL){
+            return -1;
+        }
+        out->parameters.len++;
+    }
+    return 0;
+}
+
+static int readDamageType(nbt_view element, void* data){
+    struct damageType* entry = data;
+    nbt_view messageId = nbt_view_find(element, "message_id");
+    if(element.type != TAG_COMPOUND || messageId.type != TAG_STRING){
+        return -2;
+    }
+    entry->exhaustion = nbt_view_float(nbt_view_find(element, "exhaustion"), 0.0f);
+    size_t length = 0;
+    const char* scaling = nbt_view_string(nbt_view_find(element, "scaling"), &length);
+    if(scaling == NULL){
+        return -2;
+    }
+    if(length == 5 && memcmp(scaling, "never", 5) == 0){
+        entry->scaling = NEVER_SCALES;
+    }
+    else if(length == 6 && memcmp(scaling, "always", 6) == 0){
+        entry->scaling = ALWAYS_SCALES;
+    }
+    else{
+        entry->scaling = SCALES_WHEN_CAUSED_BY_LIVING_NON_PLAYER;
+    }
+    entry->messageId = copyViewString(messageId);
+    if(entry->messageId == NULL){
+        return -1;
+    }
+    return 0;
+}
+
+static int readBiome(nbt_view element, void* data){
+    struct biome* entry = data;
+    if(element.type != TAG_COMPOUND){
+        return -2;
+    }
+    entry->hasPrecipitation = nbt_view_byte(nbt_view_find(element, "has_precipitation"), 0) != 0;
+    entry->temperature = nbt_view_float(nbt_view_find(element, "temperature"), 0.0f);
+    entry->downfall = nbt_view_float(nbt_view_find(element, "downfall"), 0.0f);
+    nbt_view effects = nbt_view_find(element, "effects");
+    entry->skyColor = nbt_view_int(nbt_view_find(effects, "sky_color"), 0);
+    entry->fogColor = nbt_view_int(nbt_view_find(effects, "fog_color"), 0);
+    entry->waterColor = nbt_view_int(nbt_view_find(effects, "water_color"), 0);
+    entry->waterFogColor = nbt_view_int(nbt_view_find(effects, "water_fog_color"), 0);
+    return 0;
+}
+
+static void freeChatDecoration(struct chatDecoration* decoration){
+    free(decoration->translationKey);
+    for(size_t i = 0; i < decoration->parameters.len; i++){
+        free(decoration->parameters.arr[i]);
+    }
+    free(decoration->parameters.arr);
+}
+
+static void freeChatType(void* data){
+    struct chatType* entry = data;
+    freeChatDecoration(&entry->chat);
+    freeChatDecoration(&entry->narration);
+}
+
+static void freeDamageType(void* data){
+    struct damageType* entry = data;
+    free(entry->messageId);
+}
+
+static void freeNothing(void* entry){
+    (void)entry;
+}
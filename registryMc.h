@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "mcTypes.h"
+
+//Typed tables decoded from the registry codec the server sends in LOGIN_PLAY, indexed by registry id
+
+#ifndef REGISTRY_MC
+#define REGISTRY_MC
+
+#define DIMENSION_TYPE_REGISTRY "minecraft:dimension_type"
+#define CHAT_TYPE_REGISTRY "minecraft:chat_type"
+#define DAMAGE_TYPE_REGISTRY "minecraft:damage_type"
+#define BIOME_REGISTRY "minecraft:worldgen/biome"
+
+#define MAX_REGISTRY_ID 4095 //registries with larger ids are rejected instead of allocating huge tables
+
+/*!
+ @struct dimensionType
+ @brief The properties of a dimension type
+ @param name the identifier of the dimension type, NULL for ids the server never sent
+ @param minY the lowest block y coordinate, a multiple of 16
+ @param height the number of blocks above minY, a multiple of 16
+ @param logicalHeight the height portals and chorus fruit can reach
+ @param coordinateScale how much moving in this dimension moves you in the overworld
+ @param ambientLight the light level everything has at least
+ @param hasSkylight whether the sky lights up the dimension
+ @param hasCeiling whether the dimension has a bedrock ceiling
+ @param ultrawarm whether water evaporates
+ @param natural whether compasses and clocks work
+*/
+struct dimensionType{
+    identifier name;
+    int32_t minY;
+    int32_t height;
+    int32_t logicalHeight;
+    double coordinateScale;
+    float ambientLight;
+    bool hasSkylight;
+    bool hasCeiling;
+    bool ultrawarm;
+    bool natural;
+};
+
+/*!
+ @struct chatDecoration
+ @brief How a chat message gets formatted
+ @param translationKey the translation key of the format
+ @param parameters the names of the values that fill in the format, in order
+*/
+struct chatDecoration{
+    char* translationKey;
+    stringArray parameters;
+};
+
+/*!
+ @struct chatType
+ @brief A chat type, which the server references in chat packets
+ @param name the identifier of the chat type, NULL for ids the server never sent
+ @param chat how the message is displayed
+ @param narration how the message is narrated
+*/
+struct chatType{
+    identifier name;
+    struct chatDecoration chat;
+    struct chatDecoration narration;
+};
+
+//When damage scales with the difficulty
+typedef enum damage_scaling{
+    NEVER_SCALES = 0,
+    SCALES_WHEN_CAUSED_BY_LIVING_NON_PLAYER = 1,
+    ALWAYS_SCALES = 2
+} damageScaling_t;
+
+/*!
+ @struct damageType
+ @brief A damage type, which the server references in DAMAGE_EVENT
+ @param name the identifier of the damage type, NULL for ids the server never sent
+ @param messageId the id of the death message
+ @param scaling when the damage scales with the difficulty
+ @param exhaustion the exhaustion the damage causes
+*/
+struct damageType{
+    identifier name;
+    char* messageId;
+    damageScaling_t scaling;
+    float exhaustion;
+};
+
+/*!
+ @struct biome
+ @brief The properties of a biome
+ @param name the identifier of the biome, NULL for ids the server never sent
+ @param hasPrecipitation whether it rains or snows
+ @param temperature the temperature, which decides between rain and snow
+ @param downfall the humidity
+ @param skyColor the color of the sky as RGB
+ @param fogColor the color of the fog as RGB
+ @param waterColor the color of water as RGB
+ @param waterFogColor the color of the fog underwater as RGB
+*/
+struct biome{
+    identifier name;
+    bool hasPrecipitation;
+    float temperature;
+    float downfall;
+    int32_t skyColor;
+    int32_t fogColor;
+    int32_t waterColor;
+    int32_t waterFogColor;
+};
+
+/*!
+ @struct registries
+ @brief The registries a gamestate needs, each as an array indexed by registry id. A zeroed struct is empty and valid
+*/
+struct registries{
+    struct dimensionType* dimensionTypes;
+    size_t dimensionTypeCount;
+    struct chatType* chatTypes;
+    size_t chatTypeCount;
+    struct damageType* damageTypes;
+    size_t damageTypeCount;
+    struct biome* biomes;
+    size_t biomeCount;
+};
+
+//The dimension type of the overworld, for when the server doesn't send one we can use
+extern const struct dimensionType defaultDimensionType;
+
+/*!
+ @brief Gets the entry of a registry with the given id as a single array access
+ @param registries pointer to the registries
+ @param table the name of the array, like dimensionTypes
+ @param count the name of it's count, like dimensionTypeCount
+ @param id the registry id
+ @return pointer to the entry, or NULL if the id is out of range or was never sent
+*/
+#define registryEntry(registries, table, count, id) \
+    ((size_t)(id) < (registries)->count && (registries)->table[(size_t)(id)].name != NULL ? (registries)->table + (size_t)(id) : NULL)
+
+/*!
+ @brief Decodes the registries out of a registry codec. Registries the codec lacks are left empty
+ @param codec view of the registry codec, which must be a compound
+ @param out the registries, which must be empty
+ @return 0 on success, -1 for error, -2 if a registry is malformed. On error out is left empty
+*/
+int readRegistries(nbt_view codec, struct registries* out);
+
+/*!
+ @brief Finds a dimension type by name. There are only a few of them, so they are simply searched
+ @param registries the registries
+ @param name the identifier of the dimension type
+ @return the dimension type, or NULL if it wasn't sent
+*/
+const struct dimensionType* findDimensionType(const struct registries* registries, const char* name);
+
+/*!
+ @brief Frees every registry
+ @param registries the registries, which are left empty
+*/
+void freeRegistries(struct registries* registries);
+
+#endif
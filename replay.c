@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "recordingMc.h"
+#include "gamestateMc.h"
+#include "versionCacheMc.h"
+
+#define VERSION_JSON "./19.4.json"
+
+#define BIOMES_JSON "./biomes.json"
+
+#define VERSION_CACHE "./19.4.cache" //made from the json files on the first run
+
+//Replays a recording made with the client into a fresh gamestate and reports the throughput
+
+int main(int argc, char** argv){
+    if(argc < 3){
+        fprintf(stderr, "Usage: %s <recording> <protocol> [realtime|fast] [decoder threads]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    char* path = argv[1];
+    int32_t protocol = (int32_t)atoi(argv[2]);
+    bool realTime = argc > 3 && strcmp(argv[3], "realtime") == 0;
+    struct gameVersion* thisVersion = createCachedVersionStruct(VERSION_JSON, BIOMES_JSON, VERSION_CACHE, protocol);
+    if(thisVersion == NULL){
+        fprintf(stderr, "Couldn't load the version data\n");
+        return EXIT_FAILURE;
+    }
+    struct gamestate current = initGamestate();
+    int threads = argc > 4 ? atoi(argv[4]) : 0;
+    if(threads > 0 && startChunkDecoding(&current, thisVersion, threads) != 0){
+        perror("Couldn't start the chunk decoding");
+    }
+    struct replayStats stats = {};
+    int result = replayRecording(path, &current, thisVersion, realTime, &stats);
+    //the chunks still being decoded are part of the replay
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(stopChunkDecoding(&current) != 0 && result >= 0){
+        result = -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats.seconds += (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    freeGamestate(&current);
+    freeVersionStruct(thisVersion);
+    if(result < 0){
+        perror("Error encountered during the replay");
+        return EXIT_FAILURE;
+    }
+    printf("%" PRIu64 " packets, %" PRIu64 " bytes in %.3fs\n", stats.packets, stats.bytes, stats.seconds);
+    printf("%.0f packets/s, %.2f MB/s, %" PRIu64 " packets failed to parse\n", stats.packets / stats.seconds, stats.bytes / stats.seconds / 1e6, stats.errors);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,385 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "networkingMc.h"
+#include "packetDefinitions.h"
+#include "recordingMc.h"
+
+//A stand-in Minecraft server on the loopback interface, for measuring the client's login time and reaction latency without a real server
+//Linux only
+
+#define SCRIPT_ROUNDS 200 //number of keep alive and teleport pairs the built in script sends
+#define SCRIPT_INTERVAL 50000 //microseconds between two rounds of the built in script
+#define MAX_PENDING 256 //maximum number of replies we wait for at once
+#define MAX_SAMPLES 65536
+
+//A packet we expect the client to answer
+struct pendingReply{
+    int replyId; //the id of the packet the client should answer with
+    int64_t key; //the keep alive id or the teleport id
+    struct timespec sent;
+    bool used;
+};
+
+//Everything measured on a single connection
+struct measurements{
+    struct pendingReply pending[MAX_PENDING];
+    double samples[MAX_SAMPLES]; //reply latencies in seconds
+    size_t sampleCount;
+    size_t unexpected; //replies we weren't waiting for
+};
+
+/*!
+ @brief Gets the number of seconds between two points in time
+ @param from the earlier point in time
+ @param to the later point in time
+ @return the number of seconds
+*/
+static double timeBetween(const struct timespec* from, const struct timespec* to);
+
+/*!
+ @brief Sends a play packet and remembers when it was sent, if the client has to answer it
+ @param conn the connection to the client
+ @param p the packet to send
+ @param compression the established compression level
+ @param m the measurements of the connection
+ @return the number of bytes written, or -1 for error
+*/
+static ssize_t sendPlayPacket(struct connection* conn, const packet* p, int compression, struct measurements* m);
+
+/*!
+ @brief Reads the client's replies until the given point in time and timestamps the ones we are waiting for
+ @param conn the connection to the client
+ @param compression the established compression level
+ @param until when to stop waiting
+ @param m the measurements of the connection
+ @return 0 on success, -1 if the client went away
+*/
+static int collectReplies(struct connection* conn, int compression, const struct timespec* until, struct measurements* m);
+
+/*!
+ @brief Sends the built in script of keep alives and teleports
+ @param conn the connection to the client
+ @param compression the established compression level
+ @param m the measurements of the connection
+ @return 0 on success, -1 if the client went away
+*/
+static int playScript(struct connection* conn, int compression, struct measurements* m);
+
+/*!
+ @brief Sends the play packets of a recording, spaced out as they were recorded
+ @param conn the connection to the client
+ @param compression the established compression level
+ @param path the path of the recording
+ @param m the measurements of the connection
+ @return 0 on success, -1 for error
+*/
+static int playRecording(struct connection* conn, int compression, const char* path, struct measurements* m);
+
+/*!
+ @brief Compares two doubles for qsort
+ @param a pointer to the first double
+ @param b pointer to the second double
+ @return negative, zero or positive just like strcmp
+*/
+static int compareDoubles(const void* a, const void* b);
+
+/*!
+ @brief Prints the reply latency percentiles
+ @param m the measurements of the connection
+*/
+static void printLatencies(struct measurements* m);
+
+/*!
+ @brief Serves a single connection from the handshake onwards
+ @param conn the connection to the client
+ @param compression the compression threshold to set during login, or NO_COMPRESSION
+ @param recording the path of a recording to stream in play state, or NULL for the built in script
+ @return 0 on success, -1 for error
+*/
+static int serveClient(struct connection* conn, int compression, const char* recording);
+
+int main(int argc, char** argv){
+    if(argc < 2){
+        fprintf(stderr, "Usage: %s <port> [compression threshold] [recording]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    uint16_t port = (uint16_t)atoi(argv[1]);
+    int compression = argc > 2 ? atoi(argv[2]) : NO_COMPRESSION;
+    const char* recording = argc > 3 ? argv[3] : NULL;
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if(listenFd < 0){
+        perror("Socket creation failed");
+        return EXIT_FAILURE;
+    }
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if(bind(listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, 16) != 0){
+        perror("Couldn't listen on the port");
+        return EXIT_FAILURE;
+    }
+    printf("Listening on 127.0.0.1:%d\n", port);
+    fflush(stdout);
+    while(true){ //the client connects once for the status and once for the login
+        int clientFd = accept(listenFd, NULL, NULL);
+        if(clientFd < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            perror("Accept failed");
+            break;
+        }
+        struct connection* conn = initConnection(clientFd);
+        if(conn != NULL){
+            serveClient(conn, compression, recording);
+            freeConnection(conn);
+        }
+        close(clientFd);
+        fflush(stdout);
+    }
+    close(listenFd);
+    return EXIT_SUCCESS;
+}
+
+static int serveClient(struct connection* conn, int compression, const char* recording){
+    struct timespec accepted;
+    clock_gettime(CLOCK_MONOTONIC, &accepted);
+    packet p = getPacket(conn, NO_COMPRESSION);
+    if(p.data == NULL || p.packetId != HANDSHAKE){
+        return -1;
+    }
+    int offset = 0;
+    int32_t protocol = readVarInt(p.data, &offset);
+    offset += readVarInt(p.data, &offset); //host
+    offset += sizeof(uint16_t); //port
+    int32_t nextState = readVarInt(p.data, &offset);
+    releasePacket(conn, &p);
+    if(nextState == STATUS_STATE){
+        while((p = getPacket(conn, NO_COMPRESSION)).data != NULL){
+            if(p.packetId == STATUS_REQUEST){
+                char status[256] = {};
+                int len = snprintf(status, sizeof(status), "{\"version\":{\"name\":\"segfaultCraft\",\"protocol\":%d},\"players\":{\"max\":1,\"online\":0},\"description\":{\"text\":\"segfaultCraft test server\"}}", protocol);
+                byte data[sizeof(status) + MAX_VAR_INT] = {};
+                size_t size = writeString(data, status, len);
+                sendPacket(conn, size, STATUS_RESPONSE, data, NO_COMPRESSION);
+            }
+            else if(p.packetId == PING_REQUEST){
+                sendPacket(conn, p.size, PING_RESPONSE, p.data, NO_COMPRESSION);
+            }
+            releasePacket(conn, &p);
+        }
+        printf("Served the status\n");
+        return 0;
+    }
+    //login
+    p = getPacket(conn, NO_COMPRESSION);
+    if(p.data == NULL || p.packetId != LOGIN_START){
+        return -1;
+    }
+    offset = 0;
+    char* username = readString(p.data, &offset);
+    releasePacket(conn, &p);
+    if(compression > NO_COMPRESSION){
+        byte data[MAX_VAR_INT] = {};
+        sendPacket(conn, writeVarInt(data, compression), SET_COMPRESSION, data, NO_COMPRESSION);
+    }
+    size_t nameLen = strlen(username);
+    byte* success = calloc(sizeof(UUID_t) + MAX_VAR_INT * 2 + nameLen, 1);
+    size_t size = sizeof(UUID_t);
+    size += writeString(success + size, username, nameLen);
+    size += writeVarInt(success + size, 0); //no properties
+    sendPacket(conn, size, LOGIN_SUCCESS, success, compression);
+    free(success);
+    struct timespec loggedIn;
+    clock_gettime(CLOCK_MONOTONIC, &loggedIn);
+    printf("%s logged in %.3fms after connecting\n", username, timeBetween(&accepted, &loggedIn) * 1e3);
+    free(username);
+    struct measurements* m = calloc(1, sizeof(struct measurements));
+    if(m == NULL){
+        return -1;
+    }
+    int result = recording != NULL ? playRecording(conn, compression, recording, m) : playScript(conn, compression, m);
+    //give the client a moment to answer the last packets, then send it off
+    struct timespec until;
+    clock_gettime(CLOCK_MONOTONIC, &until);
+    until.tv_sec += 1;
+    collectReplies(conn, compression, &until, m);
+    const char* reason = "\"Test finished\"";
+    byte data[64] = {};
+    sendPacket(conn, writeString(data, reason, strlen(reason)), DISCONNECT_PLAY, data, compression);
+    printLatencies(m);
+    free(m);
+    return result;
+}
+
+static int playScript(struct connection* conn, int compression, struct measurements* m){
+    struct timespec due;
+    clock_gettime(CLOCK_MONOTONIC, &due);
+    for(int i = 0; i < SCRIPT_ROUNDS; i++){
+        int64_t aliveId = i;
+        packet keepAlive = {sizeof(int64_t), KEEP_ALIVE, (byte*)&aliveId};
+        //position, rotation and flags all zeroed, then the teleport id and the dismount flag
+        byte teleport[TELEPORT_ID_OFFSET + MAX_VAR_INT + 1] = {};
+        size_t size = TELEPORT_ID_OFFSET + writeVarInt(teleport + TELEPORT_ID_OFFSET, i);
+        size++;
+        packet sync = {size, SYNCHRONIZE_PLAYER_POSITION, teleport};
+        if(sendPlayPacket(conn, &keepAlive, compression, m) < 0 || sendPlayPacket(conn, &sync, compression, m) < 0){
+            return -1;
+        }
+        due.tv_nsec += SCRIPT_INTERVAL * 1000;
+        due.tv_sec += due.tv_nsec / 1000000000;
+        due.tv_nsec %= 1000000000;
+        if(collectReplies(conn, compression, &due, m) != 0){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int playRecording(struct connection* conn, int compression, const char* path, struct measurements* m){
+    FILE* file = openRecording(path);
+    if(file == NULL){
+        perror("Couldn't open the recording");
+        return -1;
+    }
+    packet p = nullPacket;
+    size_t capacity = 0;
+    int32_t delay;
+    int recordedCompression;
+    int result = 0;
+    struct timespec due;
+    clock_gettime(CLOCK_MONOTONIC, &due);
+    while((result = readRecordedPacket(file, &p, &capacity, &delay, &recordedCompression)) == 0){
+        due.tv_nsec += (long)(delay % 1000000) * 1000;
+        due.tv_sec += delay / 1000000 + due.tv_nsec / 1000000000;
+        due.tv_nsec %= 1000000000;
+        if(collectReplies(conn, compression, &due, m) != 0 || sendPlayPacket(conn, &p, compression, m) < 0){
+            result = -1;
+            break;
+        }
+    }
+    free(p.data);
+    fclose(file);
+    return result < 0 ? -1 : 0;
+}
+
+static ssize_t sendPlayPacket(struct connection* conn, const packet* p, int compression, struct measurements* m){
+    int replyId = -1;
+    int64_t key = 0;
+    if(p->packetId == KEEP_ALIVE){
+        replyId = KEEP_ALIVE_2;
+        memcpy(&key, p->data, sizeof(int64_t));
+    }
+    else if(p->packetId == SYNCHRONIZE_PLAYER_POSITION){
+        int offset = TELEPORT_ID_OFFSET;
+        replyId = CONFIRM_TELEPORTATION;
+        key = readVarInt(p->data, &offset);
+    }
+    if(replyId != -1){
+        for(int i = 0; i < MAX_PENDING; i++){
+            struct pendingReply* pending = m->pending + i;
+            if(!pending->used){
+                pending->used = true;
+                pending->replyId = replyId;
+                pending->key = key;
+                clock_gettime(CLOCK_MONOTONIC, &pending->sent);
+                break;
+            }
+        }
+    }
+    return sendPacket(conn, p->size, p->packetId, p->data, compression);
+}
+
+static int collectReplies(struct connection* conn, int compression, const struct timespec* until, struct measurements* m){
+    while(true){
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double left = timeBetween(&now, until);
+        //bytes that are already buffered don't show up in poll
+        bool buffered = conn->in.end > conn->in.start;
+        if(left <= 0 && !buffered){
+            return 0;
+        }
+        if(!buffered){
+            struct pollfd pfd = {conn->socketFd, POLLIN, 0};
+            int ready = poll(&pfd, 1, (int)(left * 1e3) + 1);
+            if(ready < 0 && errno != EINTR){
+                return -1;
+            }
+            if(ready < 1){
+                continue;
+            }
+        }
+        packet reply = getPacket(conn, compression);
+        if(reply.data == NULL){
+            return -1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t key = 0;
+        if(reply.packetId == KEEP_ALIVE_2 && reply.size >= (int)sizeof(int64_t)){
+            memcpy(&key, reply.data, sizeof(int64_t));
+        }
+        else if(reply.packetId == CONFIRM_TELEPORTATION && reply.size > 0){
+            int offset = 0;
+            key = readVarInt(reply.data, &offset);
+        }
+        bool expected = false;
+        for(int i = 0; i < MAX_PENDING && (reply.packetId == KEEP_ALIVE_2 || reply.packetId == CONFIRM_TELEPORTATION); i++){
+            struct pendingReply* pending = m->pending + i;
+            if(pending->used && pending->replyId == reply.packetId && pending->key == key){
+                pending->used = false;
+                if(m->sampleCount < MAX_SAMPLES){
+                    m->samples[m->sampleCount++] = timeBetween(&pending->sent, &now);
+                }
+                expected = true;
+                break;
+            }
+        }
+        if(!expected){
+            m->unexpected++;
+        }
+        releasePacket(conn, &reply);
+    }
+}
+
+static int compareDoubles(const void* a, const void* b){
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void printLatencies(struct measurements* m){
+    size_t missing = 0;
+    for(int i = 0; i < MAX_PENDING; i++){
+        missing += m->pending[i].used;
+    }
+    printf("%zu replies timed, %zu unanswered, %zu unexpected\n", m->sampleCount, missing, m->unexpected);
+    if(m->sampleCount == 0){
+        return;
+    }
+    qsort(m->samples, m->sampleCount, sizeof(double), compareDoubles);
+    double sum = 0;
+    for(size_t i = 0; i < m->sampleCount; i++){
+        sum += m->samples[i];
+    }
+    printf("reply latency: min %.3fms, avg %.3fms, p50 %.3fms, p99 %.3fms, max %.3fms\n", m->samples[0] * 1e3, sum / m->sampleCount * 1e3, m->samples[m->sampleCount / 2] * 1e3, m->samples[m->sampleCount * 99 / 100] * 1e3, m->samples[m->sampleCount - 1] * 1e3);
+}
+
+static double timeBetween(const struct timespec* from, const struct timespec* to){
+    return (double)(to->tv_sec - from->tv_sec) + (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
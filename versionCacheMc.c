@@ -0,0 +1,431 @@
+#include "versionCacheMc.h"
+#include "gamestateMc.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#include <io.h>
+#include <process.h>
+#define getpid _getpid
+#endif
+
+//Private types
+
+/*!
+ @struct cacheLayout
+ @brief Where each array of a cache file starts, as computed from the header
+*/
+struct cacheLayout{
+    size_t entityNames;
+    size_t blockTypeNames;
+    size_t blockStateNames;
+    size_t biomeNames;
+    size_t airTypeNames;
+    size_t airStates;
+    size_t stateTypes;
+    size_t strings;
+    size_t size;
+};
+
+//A growable string table
+struct stringTable{
+    char* bytes;
+    size_t size;
+    size_t capacity;
+};
+
+//Private functions
+
+/*!
+ @brief Computes where each array of a cache file starts
+ @param header the header of the cache
+ @return the layout
+*/
+static struct cacheLayout cacheLayoutOf(const struct versionCacheHeader* header);
+
+/*!
+ @brief Gets the size and modification time of a file
+ @param path the path of the file
+ @param size pointer to where the size should be stored
+ @param time pointer to where the modification time in nanoseconds should be stored
+ @return 0 on success, -1 if the file can't be stat'ed
+*/
+static int fileIdentity(const char* path, uint64_t* size, int64_t* time);
+
+/*!
+ @brief Appends a string to the string table
+ @param table the string table
+ @param s the string, or NULL
+ @param offset pointer to where the offset of the string should be stored, VERSION_CACHE_NO_NAME for NULL
+ @return 0 on success, -1 for error
+*/
+static int addString(struct stringTable* table, const char* s, uint32_t* offset);
+
+/*!
+ @brief Builds the name offsets of a palette
+ @param table the string table the names are added to
+ @param palette the palette
+ @param names the array of offsets to fill, with one entry per palette entry
+ @return 0 on success, -1 for error
+*/
+static int addPalette(struct stringTable* table, const struct palette* palette, uint32_t* names);
+
+/*!
+ @brief Creates a palette whose names point into the mapped string table
+ @param base the start of the mapped cache
+ @param layout the layout of the cache
+ @param header the header of the cache
+ @param names the offset of the name array within the cache
+ @param count the number of names
+ @param out the palette to fill
+ @return 0 on success, -1 for error, -2 if a name points outside of the string table
+*/
+static int mapPalette(const byte* base, const struct cacheLayout* layout, const struct versionCacheHeader* header, size_t names, uint32_t count, struct palette* out);
+
+/*!
+ @brief Maps a whole file read-only
+ @param path the path of the file
+ @param size pointer to where the size of the file should be stored
+ @return the mapping, or NULL on error
+*/
+static void* mapFile(const char* path, size_t* size);
+
+/*!
+ @brief Releases a mapping made by mapFile
+*/
+static void unmapFile(void* mapping, size_t size);
+
+int writeVersionCache(const struct gameVersion* version, const char* cachePath, const char* versionJSON, const char* biomesJSON){
+    struct versionCacheHeader header = {};
+    memcpy(header.magic, VERSION_CACHE_MAGIC, sizeof(header.magic));
+    header.formatVersion = VERSION_CACHE_VERSION;
+    header.protocol = version->protocol;
+    if(fileIdentity(versionJSON, &header.versionSize, &header.versionTime) != 0 || fileIdentity(biomesJSON, &header.biomesSize, &header.biomesTime) != 0){
+        return -1;
+    }
+    header.entityCount = version->entities.sz;
+    header.blockTypeCount = version->blockTypes.sz;
+    header.blockStateCount = version->blockStates.sz;
+    header.biomeCount = version->biomes.sz;
+    header.airTypeCount = version->airTypes.sz;
+    size_t nameCount = (size_t)header.entityCount + header.blockTypeCount + header.blockStateCount + header.biomeCount + header.airTypeCount;
+    uint32_t* names = malloc((nameCount + 1) * sizeof(uint32_t));
+    if(names == NULL){
+        return -1;
+    }
+    uint32_t* blockTypeNames = names + header.entityCount;
+    uint32_t* blockStateNames = blockTypeNames + header.blockTypeCount;
+    uint32_t* biomeNames = blockStateNames + header.blockStateCount;
+    uint32_t* airTypeNames = biomeNames + header.biomeCount;
+    struct stringTable table = {};
+    int res = addPalette(&table, &version->entities, names);
+    if(res == 0){
+        res = addPalette(&table, &version->blockTypes, blockTypeNames);
+    }
+    //block states and air types share their names with block types, so those names are only stored once
+    for(uint32_t s = 0; res == 0 && s < header.blockStateCount; s++){
+        const char* name = version->blockStates.palette[s];
+        int32_t type = version->stateTypes[s];
+        if(name != NULL && type >= 0 && (uint32_t)type < header.blockTypeCount && version->blockTypes.palette[type] == name){
+            blockStateNames[s] = blockTypeNames[type];
+        }
+        else{
+            res = addString(&table, name, blockStateNames + s);
+        }
+    }
+    if(res == 0){
+        res = addPalette(&table, &version->biomes, biomeNames);
+    }
+    for(uint32_t a = 0; res == 0 && a < header.airTypeCount; a++){
+        airTypeNames[a] = VERSION_CACHE_NO_NAME;
+        for(uint32_t t = 0; t < header.blockTypeCount; t++){
+            if(version->blockTypes.palette[t] == version->airTypes.palette[a]){
+                airTypeNames[a] = blockTypeNames[t];
+                break;
+            }
+        }
+        if(airTypeNames[a] == VERSION_CACHE_NO_NAME){
+            res = addString(&table, version->airTypes.palette[a], airTypeNames + a);
+        }
+    }
+    header.stringsSize = table.size;
+    struct cacheLayout layout = cacheLayoutOf(&header);
+    size_t paddingSize = layout.airStates - (layout.entityNames + nameCount * sizeof(uint32_t));
+    //the cache is written under a name of our own, so that processes building it at the same time don't write into the same file
+    char* tempPath = malloc(strlen(cachePath) + 32);
+    if(res == 0 && tempPath != NULL){
+        sprintf(tempPath, "%s.%d.tmp", cachePath, (int)getpid());
+        FILE* file = fopen(tempPath, "wb");
+        if(file != NULL){
+            static const byte padding[8] = {};
+            bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                fwrite(names, sizeof(uint32_t), nameCount, file) == nameCount &&
+                fwrite(padding, 1, paddingSize, file) == paddingSize &&
+                fwrite(version->airStates, sizeof(uint64_t), (header.blockStateCount + 63) / 64, file) == (header.blockStateCount + 63) / 64 &&
+                fwrite(version->stateTypes, sizeof(int32_t), header.blockStateCount, file) == header.blockStateCount &&
+                fwrite(table.bytes, 1, table.size, file) == table.size;
+            if(fclose(file) != 0){
+                written = false;
+            }
+#if defined(_WIN32)
+            if(written){
+                remove(cachePath); //rename doesn't replace files on Windows
+            }
+#endif
+            if(!written || rename(tempPath, cachePath) != 0){
+                remove(tempPath);
+                res = -1;
+            }
+        }
+        else{
+            res = -1;
+        }
+    }
+    else{
+        res = -1;
+    }
+    free(tempPath);
+    free(table.bytes);
+    free(names);
+    return res;
+}
+
+struct gameVersion* loadVersionCache(const char* cachePath, const char* versionJSON, const char* biomesJSON, uint32_t protocol){
+    size_t size = 0;
+    byte* base = mapFile(cachePath, &size);
+    if(base == NULL){
+        return NULL;
+    }
+    const struct versionCacheHeader* header = (const struct versionCacheHeader*)base;
+    if(size < sizeof(struct versionCacheHeader) || memcmp(header->magic, VERSION_CACHE_MAGIC, sizeof(header->magic)) != 0 || header->formatVersion != VERSION_CACHE_VERSION || header->protocol != protocol){
+        unmapFile(base, size);
+        errno = EINVAL;
+        return NULL;
+    }
+    //json files that are gone don't make the cache stale, so that the cache can be shipped on it's own
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if((fileIdentity(versionJSON, &sourceSize, &sourceTime) == 0 && (sourceSize != header->versionSize || sourceTime != header->versionTime)) ||
+        (fileIdentity(biomesJSON, &sourceSize, &sourceTime) == 0 && (sourceSize != header->biomesSize || sourceTime != header->biomesTime))){
+        unmapFile(base, size);
+        errno = ESTALE;
+        return NULL;
+    }
+    struct cacheLayout layout = cacheLayoutOf(header);
+    if(layout.size != size || header->stringsSize == 0 || base[size - 1] != '\0'){
+        unmapFile(base, size);
+        errno = EINVAL;
+        return NULL;
+    }
+    struct gameVersion* version = calloc(1, sizeof(struct gameVersion));
+    if(version == NULL){
+        unmapFile(base, size);
+        return NULL;
+    }
+    version->cache = base;
+    version->cacheSize = size;
+    version->protocol = protocol;
+    int res = mapPalette(base, &layout, header, layout.entityNames, header->entityCount, &version->entities);
+    if(res == 0){
+        res = mapPalette(base, &layout, header, layout.blockTypeNames, header->blockTypeCount, &version->blockTypes);
+    }
+    if(res == 0){
+        res = mapPalette(base, &layout, header, layout.blockStateNames, header->blockStateCount, &version->blockStates);
+    }
+    if(res == 0){
+        res = mapPalette(base, &layout, header, layout.biomeNames, header->biomeCount, &version->biomes);
+    }
+    if(res == 0){
+        res = mapPalette(base, &layout, header, layout.airTypeNames, header->airTypeCount, &version->airTypes);
+    }
+    //the dense tables are used straight from the mapping. Nothing writes to them once a version is created
+    version->airStates = (uint64_t*)(base + layout.airStates);
+    version->stateTypes = (int32_t*)(base + layout.stateTypes);
+    for(uint32_t s = 0; res == 0 && s < header->blockStateCount; s++){
+        if(version->stateTypes[s] < 0 || ((uint32_t)version->stateTypes[s] >= header->blockTypeCount && header->blockTypeCount > 0)){
+            res = -2;
+        }
+    }
+    if(res != 0){
+        freeVersionCache(version);
+        if(res == -2){
+            errno = EINVAL;
+        }
+        return NULL;
+    }
+    return version;
+}
+
+struct gameVersion* createCachedVersionStruct(const char* versionJSON, const char* biomesJSON, const char* cachePath, uint32_t protocol){
+    struct gameVersion* version = loadVersionCache(cachePath, versionJSON, biomesJSON, protocol);
+    if(version != NULL){
+        return version;
+    }
+    version = createVersionStruct(versionJSON, biomesJSON, protocol);
+    if(version != NULL){
+        writeVersionCache(version, cachePath, versionJSON, biomesJSON); //without a cache the next run simply parses the json again
+    }
+    return version;
+}
+
+void freeVersionCache(struct gameVersion* version){
+    free(version->entities.palette);
+    free(version->blockTypes.palette);
+    free(version->blockStates.palette);
+    free(version->biomes.palette);
+    free(version->airTypes.palette);
+    unmapFile(version->cache, version->cacheSize);
+    free(version);
+}
+
+static struct cacheLayout cacheLayoutOf(const struct versionCacheHeader* header){
+    struct cacheLayout layout;
+    layout.entityNames = sizeof(struct versionCacheHeader);
+    layout.blockTypeNames = layout.entityNames + (size_t)header->entityCount * sizeof(uint32_t);
+    layout.blockStateNames = layout.blockTypeNames + (size_t)header->blockTypeCount * sizeof(uint32_t);
+    layout.biomeNames = layout.blockStateNames + (size_t)header->blockStateCount * sizeof(uint32_t);
+    layout.airTypeNames = layout.biomeNames + (size_t)header->biomeCount * sizeof(uint32_t);
+    layout.airStates = (layout.airTypeNames + (size_t)header->airTypeCount * sizeof(uint32_t) + 7) & ~(size_t)7;
+    layout.stateTypes = layout.airStates + (((size_t)header->blockStateCount + 63) / 64) * sizeof(uint64_t);
+    layout.strings = layout.stateTypes + (size_t)header->blockStateCount * sizeof(int32_t);
+    layout.size = layout.strings + header->stringsSize;
+    return layout;
+}
+
+static int fileIdentity(const char* path, uint64_t* size, int64_t* time){
+    struct stat st;
+    if(stat(path, &st) != 0){
+        return -1;
+    }
+    *size = (uint64_t)st.st_size;
+#if defined(__APPLE__)
+    *time = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(__unix__)
+    *time = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    *time = (int64_t)st.st_mtime * 1000000000;
+#endif
+    return 0;
+}
+
+static int addString(struct stringTable* table, const char* s, uint32_t* offset){
+    if(s == NULL){
+        *offset = VERSION_CACHE_NO_NAME;
+        return 0;
+    }
+    size_t length = strlen(s) + 1;
+    if(table->size + length >= VERSION_CACHE_NO_NAME){
+        errno = EOVERFLOW;
+        return -1;
+    }
+    if(table->size + length > table->capacity){
+        size_t capacity = table->capacity == 0 ? 4096 : table->capacity;
+        while(capacity < table->size + length){
+            capacity *= 2;
+        }
+        char* bytes = realloc(table->bytes, capacity);
+        if(bytes == NULL){
+            return -1;
+        }
+        table->bytes = bytes;
+        table->capacity = capacity;
+    }
+    memcpy(table->bytes + table->size, s, length);
+    *offset = (uint32_t)table->size;
+    table->size += length;
+    return 0;
+}
+
+static int addPalette(struct stringTable* table, const struct palette* palette, uint32_t* names){
+    for(size_t i = 0; i < palette->sz; i++){
+        if(addString(table, palette->palette[i], names + i) != 0){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int mapPalette(const byte* base, const struct cacheLayout* layout, const struct versionCacheHeader* header, size_t names, uint32_t count, struct palette* out){
+    out->sz = count;
+    if(count == 0){
+        return 0;
+    }
+    out->palette = calloc(count, sizeof(identifier));
+    if(out->palette == NULL){
+        return -1;
+    }
+    const uint32_t* offsets = (const uint32_t*)(base + names);
+    for(uint32_t i = 0; i < count; i++){
+        if(offsets[i] == VERSION_CACHE_NO_NAME){
+            continue;
+        }
+        if(offsets[i] >= header->stringsSize){
+            return -2;
+        }
+        //the mapping is read-only, identifier just isn't const
+        out->palette[i] = (identifier)(base + layout->strings + offsets[i]);
+    }
+    return 0;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+static void* mapFile(const char* path, size_t* size){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        return NULL;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0){
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void* mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); //the mapping keeps the file open
+    if(mapping == MAP_FAILED){
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    return mapping;
+}
+
+static void unmapFile(void* mapping, size_t size){
+    munmap(mapping, size);
+}
+
+#elif defined(_WIN32)
+
+//there is no mmap, so the cache is read into memory instead, which still skips the json parsing
+static void* mapFile(const char* path, size_t* size){
+    FILE* file = fopen(path, "rb");
+    if(file == NULL){
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long sz = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    void* mapping = sz > 0 ? malloc(sz) : NULL;
+    if(mapping == NULL || fread(mapping, sz, 1, file) != 1){
+        free(mapping);
+        fclose(file);
+        errno = EINVAL;
+        return NULL;
+    }
+    fclose(file);
+    *size = (size_t)sz;
+    return mapping;
+}
+
+static void unmapFile(void* mapping, size_t size){
+    free(mapping);
+}
+
+#endif
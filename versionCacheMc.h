@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "mcTypes.h"
+
+//Precompiled binary copy of the game version data, which later runs map read-only instead of parsing the pixlyzer json again
+
+#ifndef VERSION_CACHE_MC
+#define VERSION_CACHE_MC
+
+#define VERSION_CACHE_MAGIC "SCVC"
+#define VERSION_CACHE_VERSION 2
+
+/*Version cache format note
+The file is a versionCacheHeader followed by these arrays, in native byte order since the cache never leaves the machine that made it:
+uint32 entity names | uint32 block type names | uint32 block state names | uint32 biome names | uint32 air type names | padding to 8 bytes |
+uint64 airStates bitmap | int32 stateTypes | string table
+Every name is an offset into the string table of a NULL-terminated string, or VERSION_CACHE_NO_NAME for a gap in the palette.
+The header remembers the size and modification time of both json files, so a cache made from other files is rebuilt.
+Since the file is mapped read-only, every process using it shares the same pages. Only the palettes, which have to hold pointers, are allocated per process
+*/
+
+#define VERSION_CACHE_NO_NAME UINT32_MAX
+
+struct gameVersion;
+
+/*!
+ @struct versionCacheHeader
+ @brief The start of a version cache file
+ @param magic VERSION_CACHE_MAGIC
+ @param formatVersion VERSION_CACHE_VERSION
+ @param protocol the protocol the cache was made for
+ @param versionSize the size of the version json the cache was made from
+ @param versionTime the modification time of the version json in nanoseconds
+ @param biomesSize the size of the biomes json the cache was made from
+ @param biomesTime the modification time of the biomes json in nanoseconds
+ @param entityCount the number of entity names
+ @param blockTypeCount the number of block type names
+ @param blockStateCount the number of block states
+ @param biomeCount the number of biome names
+ @param airTypeCount the number of air type names
+ @param stringsSize the size of the string table in bytes
+*/
+struct versionCacheHeader{
+    char magic[4];
+    uint32_t formatVersion;
+    uint32_t protocol;
+    uint32_t entityCount;
+    uint64_t versionSize;
+    int64_t versionTime;
+    uint64_t biomesSize;
+    int64_t biomesTime;
+    uint32_t blockTypeCount;
+    uint32_t blockStateCount;
+    uint32_t biomeCount;
+    uint32_t airTypeCount;
+    uint64_t stringsSize;
+};
+
+/*!
+ @brief Writes a version struct into a cache file. The file is written under a temporary name and then renamed, so that other processes never map a half written cache
+ @param version the version struct to write
+ @param cachePath the path of the cache file
+ @param versionJSON the version json the struct was made from
+ @param biomesJSON the biomes json the struct was made from
+ @return 0 on success, -1 for error
+*/
+int writeVersionCache(const struct gameVersion* version, const char* cachePath, const char* versionJSON, const char* biomesJSON);
+
+/*!
+ @brief Maps a cache file as a version struct
+ @param cachePath the path of the cache file
+ @param versionJSON the version json, which the cache must have been made from. If it doesn't exist the cache is used as is
+ @param biomesJSON the biomes json, checked just like versionJSON
+ @param protocol the protocol the cache must have been made for
+ @return the version struct, which must be freed with freeVersionStruct, or NULL if the cache is missing, stale or malformed
+*/
+struct gameVersion* loadVersionCache(const char* cachePath, const char* versionJSON, const char* biomesJSON, uint32_t protocol);
+
+/*!
+ @brief Creates a version struct from the cache, or from the json if there is no usable cache, in which case the cache is written for the next run
+ @param versionJSON the version json
+ @param biomesJSON the biomes json
+ @param cachePath the path of the cache file
+ @param protocol the protocol of the version
+ @return the version struct, which must be freed with freeVersionStruct, or NULL on error
+*/
+struct gameVersion* createCachedVersionStruct(const char* versionJSON, const char* biomesJSON, const char* cachePath, uint32_t protocol);
+
+/*!
+ @brief Frees a version struct that was loaded from a cache, unmapping the cache
+ @param version the version struct
+*/
+void freeVersionCache(struct gameVersion* version);
+
+#endif